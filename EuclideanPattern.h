@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    Euclidean rhythm generation, every pattern the plugin can ask for
+    built at compile time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace EuclideanPattern
+{
+    constexpr int maxSteps = 32;
+
+    // the bits an orbit of 'steps' length occupies
+    constexpr juce::uint32 lengthMask(int steps) noexcept
+    {
+        return steps >= 32 ? 0xffffffffu : ((juce::uint32)1 << steps) - 1;
+    }
+
+    // bit i of the result is set when step i carries a pulse
+    constexpr juce::uint32 generate(int steps, int pulses) noexcept
+    {
+        if (steps <= 0 || pulses <= 0)
+            return 0;
+
+        if (pulses >= steps)
+            return lengthMask(steps);
+
+        juce::uint32 mask = 0;
+
+        for (int k = 0; k < pulses; ++k)
+            mask |= (juce::uint32)1 << ((k * steps + pulses - 1) / pulses);
+
+        return mask;
+    }
+
+    struct Table
+    {
+        juce::uint32 masks[maxSteps][maxSteps + 1]; // [steps - 1][pulses]
+    };
+
+    constexpr Table buildTable() noexcept
+    {
+        Table t {};
+
+        for (int s = 1; s <= maxSteps; ++s)
+            for (int p = 0; p <= maxSteps; ++p)
+                t.masks[s - 1][p] = generate(s, p);
+
+        return t;
+    }
+
+    constexpr Table table = buildTable();
+
+    static_assert(table.masks[8 - 1][3] == 0x49, "E(3,8) should be x..x..x.");
+    static_assert(table.masks[16 - 1][4] == 0x1111, "E(4,16) should be four on the floor");
+    static_assert(table.masks[5 - 1][2] == 0x9, "E(2,5) should be x..x.");
+    static_assert(table.masks[32 - 1][32] == 0xffffffffu, "a full orbit should pulse on every step");
+
+    // steps outside 1..32 and pulses outside 0..steps are clamped
+    inline juce::uint32 get(int steps, int pulses) noexcept
+    {
+        steps = juce::jlimit(1, maxSteps, steps);
+        pulses = juce::jlimit(0, steps, pulses);
+        return table.masks[steps - 1][pulses];
+    }
+
+    //==============================================================================
+    // bit operations on an orbit mask of 'steps' length
+
+    constexpr bool isPulse(juce::uint32 mask, int step) noexcept
+    {
+        return step >= 0 && step < 32 && ((mask >> step) & 1) != 0;
+    }
+
+    // moves every pulse 'amount' steps later, wrapping around the orbit
+    constexpr juce::uint32 rotate(juce::uint32 mask, int steps, int amount) noexcept
+    {
+        if (steps <= 1)
+            return mask;
+
+        amount = ((amount % steps) + steps) % steps;
+
+        if (amount == 0)
+            return mask;
+
+        return ((mask << amount) | (mask >> (steps - amount))) & lengthMask(steps);
+    }
+
+    static_assert(rotate(0x49, 8, 1) == 0x92, "rotation moves pulses later");
+    static_assert(rotate(0x49, 8, 3) == 0x4a, "rotation wraps around the orbit");
+}
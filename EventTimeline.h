@@ -0,0 +1,191 @@
+/*
+  ==============================================================================
+
+    One full combined cycle of every orbit, flattened into a sorted list of
+    the ticks where something happens. Built on the message thread, walked
+    by the audio thread and the MIDI file export.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SequencerConfig.h"
+#include "EuclideanPattern.h"
+#include "StepLanes.h"
+#include "Groove.h"
+
+//==============================================================================
+class EventTimeline
+{
+public:
+    // ticks in one global step, every ClockRate step length is a whole number of these
+    static constexpr int ticksPerStep = 12;
+    static constexpr int maxEvents = 16384;
+    static constexpr juce::uint64 maxCycleTicks = 0xffffffffu;
+
+    struct OrbitLayout
+    {
+        int steps = 8;
+        juce::uint32 pattern = 0;
+        StepLanes::Lane velocity = StepLanes::filled(StepLanes::defaultVelocity);
+        StepLanes::Lane probability = StepLanes::filled(StepLanes::alwaysPlays);
+        StepLanes::Lane ratchet = StepLanes::filled(1);
+        juce::uint64 seed = 0;          // this orbit's random stream
+        bool reversed = false;
+        int stepTicks = ticksPerStep;   // length of one of this orbit's steps
+        int note = 60;                  // pitch played on its pulses
+        int channel = 1;                // ...and the midi channel, 1-16
+        float gate = 1.0f;              // fraction of a step each note is held
+        float gateMs = 0.0f;            // ...or, when above zero, how long in milliseconds
+    };
+
+    struct Event
+    {
+        juce::uint32 tick;      // position inside the cycle
+        juce::uint32 stepping;  // orbits that move to their next step here
+    };
+
+    // what an orbit plays when it moves to a step: nothing, or 'repeats' notes spread evenly across it.
+    // lengths are in whatever unit the step length was given in
+    struct StepNotes
+    {
+        int repeats = 0;                // 0 when the step is silent
+        double repeatLength = 0.0;      // from one repeat to the next
+        double gateLength = 0.0;        // how long each repeat is held
+        juce::uint8 velocity = 0;
+    };
+
+    //==============================================================================
+    /** Rebuilds the timeline. Returns false, leaving it empty, when one combined
+        cycle needs more than maxEvents events; callers then have to evaluate the
+        orbits one by one instead.
+    */
+    bool build(const std::array<OrbitLayout, numOrbits>& newLayout) noexcept
+    {
+        layout = newLayout;
+        numEvents = 0;
+        cycleTicks = 1;
+
+        for (auto& o : layout)
+        {
+            auto orbitTicks = (juce::uint64)juce::jmax(1, o.steps) * (juce::uint64)juce::jmax(1, o.stepTicks);
+            cycleTicks = cycleTicks / gcd(cycleTicks, orbitTicks) * orbitTicks;
+
+            if (cycleTicks > maxCycleTicks)
+                return invalidate();
+        }
+
+        juce::uint64 tick = 0;
+
+        while (tick < cycleTicks)
+        {
+            if (numEvents == maxEvents)
+                return invalidate();
+
+            Event e { (juce::uint32)tick, 0 };
+            auto next = cycleTicks;
+
+            for (int i = 0; i < numOrbits; i++)
+            {
+                auto stepTicks = (juce::uint64)layout[i].stepTicks;
+
+                if (tick % stepTicks == 0)
+                    e.stepping |= (1u << i);
+
+                next = juce::jmin(next, (tick / stepTicks + 1) * stepTicks);
+            }
+
+            events[numEvents++] = e;
+            tick = next;
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    bool isValid() const noexcept                   { return numEvents > 0; }
+    int size() const noexcept                       { return numEvents; }
+    juce::uint64 getCycleTicks() const noexcept     { return cycleTicks; }
+    const Event& operator[](int index) const noexcept { return events[index]; }
+
+    // first event at or after a tick inside the cycle, size() if there is none
+    int indexAtOrAfter(juce::uint64 tickInCycle) const noexcept
+    {
+        auto* e = std::lower_bound(events, events + numEvents, tickInCycle,
+                                   [](const Event& ev, juce::uint64 t) { return ev.tick < t; });
+        return (int)(e - events);
+    }
+
+    // the step an orbit is on at a tick where it steps
+    int stepAt(int orbit, juce::uint32 tick) const noexcept
+    {
+        return stepAt(layout[orbit], tick);
+    }
+
+    static int stepAt(const OrbitLayout& o, juce::uint64 tick) noexcept
+    {
+        return stepAtIndex(o, (juce::int64)(tick / (juce::uint64)o.stepTicks));
+    }
+
+    // the step an orbit plays at its index'th step since the start, which may be negative
+    static int stepAtIndex(const OrbitLayout& o, juce::int64 index) noexcept
+    {
+        auto step = (int)(((index % o.steps) + o.steps) % o.steps);
+        return o.reversed ? (o.steps - step) % o.steps : step;
+    }
+
+    /** Decides what an orbit plays on 'step', reached at 'tick'. Playback and the
+        MIDI file export both go through here, so they can't disagree about which
+        pulses play or for how long. 'unitsPerMs' turns a gate set in
+        milliseconds into the unit of 'stepLength'.
+    */
+    static StepNotes notesAt(const OrbitLayout& o, int rotation, int step, juce::uint64 tick,
+                             double stepLength, double unitsPerMs) noexcept
+    {
+        StepNotes notes;
+
+        // rotation stays out of the layout so it can be automated freely, it's one bit rotation per step
+        auto pattern = EuclideanPattern::rotate(o.pattern, o.steps, rotation);
+
+        if (! EuclideanPattern::isPulse(pattern, step) || ! StepLanes::plays(o.probability[(size_t)step], o.seed, tick))
+            return notes;
+
+        // a ratcheted step repeats its note evenly across the step. the gate is a fraction of each
+        // repeat, or a fixed time no longer than one
+        notes.repeats = juce::jlimit(1, (int)StepLanes::maxRatchets, (int)o.ratchet[(size_t)step]);
+        notes.repeatLength = stepLength / notes.repeats;
+        notes.gateLength = o.gateMs > 0.0f ? juce::jmin(notes.repeatLength, o.gateMs * unitsPerMs)
+                                           : o.gate * notes.repeatLength;
+        notes.velocity = o.velocity[(size_t)step];
+        return notes;
+    }
+
+    std::array<OrbitLayout, numOrbits> layout;
+    Groove::Template groove;    // timing of the global steps, shared by every orbit
+    juce::uint32 programSequence = 0;   // program changes the settings it was built from had caught up with
+
+private:
+    bool invalidate() noexcept
+    {
+        numEvents = 0;
+        return false;
+    }
+
+    static juce::uint64 gcd(juce::uint64 a, juce::uint64 b) noexcept
+    {
+        while (b != 0)
+        {
+            auto t = a % b;
+            a = b;
+            b = t;
+        }
+
+        return a;
+    }
+
+    juce::uint64 cycleTicks = 0;
+    int numEvents = 0;
+    Event events[maxEvents] {};
+};
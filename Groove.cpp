@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    Swing and groove templates.
+
+  ==============================================================================
+*/
+
+#include "Groove.h"
+
+Groove::Template Groove::swing(float percent) noexcept
+{
+    Template groove;
+
+    if (percent > 50.0f)
+    {
+        groove.length = 2;
+        groove.offsets[1] = juce::jmin(maxOffset, percent / 50.0f - 1.0f);
+    }
+
+    return groove;
+}
+
+Groove::Template Groove::fromSequence(const juce::MidiMessageSequence& clip, double stepLength, int length)
+{
+    Template groove;
+
+    if (stepLength <= 0.0 || length < 1)
+        return groove;
+
+    groove.length = juce::jmin(length, maxLength);
+
+    std::array<double, maxLength> total {};
+    std::array<int, maxLength> count {};
+
+    // each note counts towards the grid step nearest to it
+    for (int i = 0; i < clip.getNumEvents(); i++)
+    {
+        auto& message = clip.getEventPointer(i)->message;
+
+        if (! message.isNoteOn())
+            continue;
+
+        auto position = message.getTimeStamp() / stepLength;
+        auto step = std::round(position);
+        auto slot = (int)std::fmod(step, (double)groove.length);
+
+        if (slot < 0)
+            slot += groove.length;
+
+        total[(size_t)slot] += position - step;
+        count[(size_t)slot]++;
+    }
+
+    for (int i = 0; i < groove.length; i++)
+        if (count[(size_t)i] > 0)
+            groove.offsets[(size_t)i] = juce::jlimit(-maxOffset, maxOffset, (float)(total[(size_t)i] / count[(size_t)i]));
+
+    return groove;
+}
+
+Groove::Table Groove::scale(const Template& groove, double stepLength, double lookahead) noexcept
+{
+    Table table;
+    table.length = juce::jlimit(0, maxLength, groove.length);
+
+    for (int i = 0; i < table.length; i++)
+        table.offsets[(size_t)i] = juce::jmax(-lookahead, groove.offsets[(size_t)i] * stepLength);
+
+    return table;
+}
+
+double Groove::offsetAt(const Table& table, juce::int64 tick, int ticksPerStep) noexcept
+{
+    if (table.length == 0)
+        return 0.0;
+
+    auto step = tick >= 0 ? tick / ticksPerStep : -((-tick + ticksPerStep - 1) / ticksPerStep);
+    auto slot = (int)(step % table.length);
+
+    if (slot < 0)
+        slot += table.length;
+
+    auto within = (double)(tick - step * ticksPerStep) / ticksPerStep;
+    auto here = table.offsets[(size_t)slot];
+
+    if (within == 0.0)
+        return here;
+
+    return here + (table.offsets[(size_t)((slot + 1) % table.length)] - here) * within;
+}
@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    Swing and groove templates: a timing offset for each global step, in
+    fractions of a step, repeating every 'length' steps.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Groove
+{
+    constexpr int maxLength = 32;
+    constexpr float maxOffset = 0.5f;       // a step can move at most half a step either way
+
+    struct Template
+    {
+        int length = 0;                     // steps before it repeats, 0 for none
+        std::array<float, maxLength> offsets {};
+    };
+
+    // a template as it's played, its offsets in samples, file ticks or whatever unit the step was given in
+    struct Table
+    {
+        int length = 0;
+        std::array<double, maxLength> offsets {};
+    };
+
+    //==============================================================================
+    // MPC-style swing: every second step lands 'percent' of the way through the pair, 50 is straight
+    Template swing(float percent) noexcept;
+
+    // the average timing of the note-ons in 'clip' against a grid of 'stepLength', in the clip's time units
+    Template fromSequence(const juce::MidiMessageSequence& clip, double stepLength, int length);
+
+    // 'groove' for steps 'stepLength' long. no step is pulled earlier than 'lookahead', the time everything is
+    // played late by, as it can't be sent before the step is reached
+    Table scale(const Template& groove, double stepLength, double lookahead) noexcept;
+
+    // how far a tick is moved, 'ticksPerStep' of them to a step. ticks between two steps get a blend of both
+    double offsetAt(const Table& table, juce::int64 tick, int ticksPerStep) noexcept;
+}
@@ -0,0 +1,174 @@
+/*
+  ==============================================================================
+
+    Times processBlock across buffer sizes, sample rates, tempos and orbit
+    configurations, printing the processor's own statistics for every run,
+    then times saving and loading the state against the XML it replaced.
+
+        EuclidBench [seconds of audio per run, default 10]
+
+    Build with EUCLID_REALTIME_AUDIT on to have allocations, frees and
+    locks inside the callback counted, per block, in their own columns.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    struct Configuration
+    {
+        const char* name;
+        std::function<void(ProcessorHarness&)> apply;
+    };
+
+    void resetOrbits(ProcessorHarness& h)
+    {
+        for (int i = 0; i < numOrbits; i++)
+        {
+            h.setOrbit(i, false, 8, 3);
+
+            for (int step = 0; step < EuclideanPattern::maxSteps; step++)
+                h.processor.setStepRatchet(i, step, 1);
+        }
+
+        h.setParameter("Swing", 50.0f);
+        h.setParameter("Lookahead", 0.0f);
+    }
+
+    const Configuration configurations[]
+    {
+        { "one orbit", [](ProcessorHarness& h)
+            {
+                h.setOrbit(0, true, 16, 5);
+            } },
+
+        { "all orbits", [](ProcessorHarness& h)
+            {
+                for (int i = 0; i < numOrbits; i++)
+                    h.setOrbit(i, true, 5 + 3 * i, 2 + i);
+            } },
+
+        // every orbit on its own clock rate, still flattened into one timeline
+        { "polyrhythm", [](ProcessorHarness& h)
+            {
+                for (int i = 0; i < numOrbits; i++)
+                    h.setOrbit(i, true, 8 + i, 3 + i, (2 + 2 * i) % 11);
+            } },
+
+        // a combined cycle too long to flatten, every orbit clocked one by one
+        { "orbit clocks", [](ProcessorHarness& h)
+            {
+                const int steps[] { 29, 31, 23, 19, 17 };
+
+                for (int i = 0; i < numOrbits; i++)
+                    h.setOrbit(i, true, steps[i % 5], 7, (1 + 3 * i) % 11);
+            } },
+
+        { "ratchets and swing", [](ProcessorHarness& h)
+            {
+                for (int i = 0; i < numOrbits; i++)
+                {
+                    h.setOrbit(i, true, 16, 9, 5);
+
+                    for (int step = 0; step < EuclideanPattern::maxSteps; step += 2)
+                        h.processor.setStepRatchet(i, step, 4);
+                }
+
+                h.setParameter("Swing", 66.0f);
+                h.setParameter("Lookahead", 20.0f);
+            } },
+    };
+
+    //==============================================================================
+    // average time of one call, in microseconds
+    template <typename Operation>
+    double microsecondsPerCall(int numCalls, Operation&& operation)
+    {
+        auto startTicks = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numCalls; i++)
+            operation();
+
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks) * 1.0e6 / numCalls;
+    }
+
+    // the binary blob against the parameter tree as XML, which is what sessions were saved as before it.
+    // every save follows a change, so neither is served from the processor's cache of the last blob
+    void benchmarkState(ProcessorHarness& h)
+    {
+        constexpr int numCalls = 2000;
+        auto& processor = h.processor;
+        Groove::Template groove;
+
+        juce::MemoryBlock binary, xml;
+
+        auto binarySave = microsecondsPerCall(numCalls, [&]
+        {
+            processor.setGrooveTemplate(groove);
+            processor.getStateInformation(binary);
+        });
+
+        auto xmlSave = microsecondsPerCall(numCalls, [&]
+        {
+            processor.setGrooveTemplate(groove);
+
+            if (auto state = processor.treeState.copyState().createXml())
+                juce::AudioProcessor::copyXmlToBinary(*state, xml);
+        });
+
+        auto binaryLoad = microsecondsPerCall(numCalls, [&] { processor.setStateInformation(binary.getData(), (int)binary.getSize()); });
+        auto xmlLoad = microsecondsPerCall(numCalls, [&] { processor.setStateInformation(xml.getData(), (int)xml.getSize()); });
+
+        std::cout << "state, binary: " << binary.getSize() << " bytes, save " << juce::String(binarySave, 2)
+                  << " us, load " << juce::String(binaryLoad, 2) << " us" << std::endl;
+        std::cout << "state, xml: " << xml.getSize() << " bytes, save " << juce::String(xmlSave, 2)
+                  << " us, load " << juce::String(xmlLoad, 2) << " us" << std::endl;
+    }
+
+    const double sampleRates[] { 44100.0, 48000.0, 96000.0 };
+    const int blockSizes[] { 32, 64, 128, 256, 512, 1024, 2048 };
+    const double tempos[] { 60.0, 120.0, 174.0 };
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    auto seconds = argc > 1 ? juce::jmax(1, juce::String(argv[1]).getIntValue()) : 10;
+
+    ProcessorHarness harness;
+    harness.setParameter("Sync", 1.0f);
+
+    for (auto& configuration : configurations)
+    {
+        resetOrbits(harness);
+        configuration.apply(harness);
+        harness.settle();
+
+        for (auto sampleRate : sampleRates)
+        {
+            for (auto blockSize : blockSizes)
+            {
+                for (auto bpm : tempos)
+                {
+                    harness.prepare(sampleRate, blockSize);
+                    harness.playHead.info.bpm = bpm;
+
+                    auto startTicks = juce::Time::getHighResolutionTicks();
+                    harness.render((juce::int64)(seconds * sampleRate), blockSize);
+                    auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+                    std::cout << configuration.name << ", " << sampleRate << " Hz, " << blockSize << " samples, "
+                              << bpm << " bpm, x" << juce::String(seconds / juce::jmax(1.0e-9, elapsed), 0) << " realtime: "
+                              << harness.processor.statistics.toString() << std::endl;
+                }
+            }
+        }
+    }
+
+    benchmarkState(harness);
+    return 0;
+}
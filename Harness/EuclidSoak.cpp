@@ -0,0 +1,338 @@
+/*
+  ==============================================================================
+
+    Runs the processor for minutes with everything changing at random: an
+    audio thread renders random block sizes while the host tempo, transport
+    and incoming MIDI jump about, and the message thread meanwhile moves
+    parameters, lanes, grooves, presets and saved state underneath it.
+
+        EuclidSoak [minutes, default 2] [seed]
+
+    Every block is checked as it comes out: timestamps in order and inside
+    the block, well-formed messages, and no note started again on a pitch
+    a receiver already has sounding. At the end the transport is stopped,
+    which has to leave no note hanging. Built with EUCLID_REALTIME_AUDIT on,
+    any allocation or lock inside processBlock fails the run too.
+
+    Incoming MIDI is sent on channel 16 and the orbits play on 1 to 15, so
+    what's passed through is kept apart from what the orbits play.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    constexpr int inputChannel = 16;
+    constexpr int maxBlockSize = 2048;
+
+    // what a synth listening to the output would have sounding, and anything that went wrong
+    class Receiver
+    {
+    public:
+        void check(const std::vector<RenderedEvent>& events, juce::int64 blockStart, juce::int64 blockEnd)
+        {
+            for (auto& e : events)
+            {
+                if (e.time < lastTime || e.time < blockStart || e.time >= blockEnd)
+                    fail("out of order or outside its block", e);
+
+                lastTime = e.time;
+
+                if (e.numBytes == 0 || (e.bytes[0] & 0x80) == 0)
+                {
+                    fail("no status byte", e);
+                    continue;
+                }
+
+                for (int i = 1; i < e.numBytes; i++)
+                    if ((e.bytes[(size_t)i] & 0x80) != 0)
+                        fail("bad data byte", e);
+
+                auto channel = e.bytes[0] & 0x0f;
+
+                if (channel == inputChannel - 1)
+                    continue;
+
+                auto& sounding = notes[(size_t)channel][(size_t)(e.bytes[1] & 0x7f)];
+
+                if (e.isNoteOn())
+                {
+                    if (sounding)
+                        fail("note on for a note already sounding", e);
+
+                    sounding = true;
+                    numNotes++;
+                }
+                else if (e.isNoteOff())
+                {
+                    sounding = false;
+                }
+            }
+        }
+
+        int countSounding() const
+        {
+            auto count = 0;
+
+            for (auto& channel : notes)
+                count += (int)std::count(channel.begin(), channel.end(), true);
+
+            return count;
+        }
+
+        void fail(const juce::String& what, const RenderedEvent& e)
+        {
+            if (numFailures++ < 20)
+                std::cout << "FAILED: " << what << ": " << e.toString() << std::endl;
+        }
+
+        juce::int64 numNotes = 0;
+        int numFailures = 0;
+
+    private:
+        std::array<std::array<bool, 128>, 16> notes {};
+        juce::int64 lastTime = 0;
+    };
+
+    //==============================================================================
+    // the host's side: random blocks, transport moves and incoming MIDI
+    void renderRandomBlock(ProcessorHarness& harness, juce::Random& random, Receiver& receiver, std::vector<RenderedEvent>& events)
+    {
+        auto& info = harness.playHead.info;
+        auto now = harness.getPosition();
+        auto numSamples = random.nextInt(8) == 0 ? 1 + random.nextInt(16) : 1 + random.nextInt(maxBlockSize);
+
+        switch (random.nextInt(400))
+        {
+            case 0:     harness.setTempo(40.0 + random.nextDouble() * 200.0); break;
+            case 1:     harness.setPlaying(! info.isPlaying); break;
+            case 2:     harness.relocate(random.nextDouble() * 64.0); break;
+            case 3:     harness.relocate(juce::jmax(0.0, harness.getPpqAt(now) - random.nextDouble() * 0.01)); break;
+            case 4:     harness.playHead.hasPosition = ! harness.playHead.hasPosition; break;
+            default:    break;
+        }
+
+        if (random.nextInt(4) == 0)
+        {
+            auto time = now + random.nextInt(numSamples);
+            auto note = random.nextInt(128);
+            harness.addInput(time, juce::MidiMessage::noteOn(inputChannel, note, (juce::uint8)(1 + random.nextInt(127))));
+            harness.addInput(time + random.nextInt(4 * maxBlockSize), juce::MidiMessage::noteOff(inputChannel, note));
+        }
+
+        switch (random.nextInt(64))
+        {
+            case 0:     harness.addInput(now, juce::MidiMessage::controllerEvent(inputChannel, 1, random.nextInt(128))); break;
+            case 1:     harness.addInput(now, juce::MidiMessage::allNotesOff(inputChannel)); break;
+            case 2:     harness.addInput(now, juce::MidiMessage::programChange(inputChannel, random.nextInt(8))); break;
+            default:    break;
+        }
+
+        events.clear();
+        harness.processBlock(numSamples, &events);
+        receiver.check(events, now, now + numSamples);
+    }
+
+    //==============================================================================
+    // the editor's side: anything a user, the host or a preset can change while it plays
+    // a bank of presets to switch between, every orbit kept off the input channel
+    std::vector<PresetBank::Preset> makeRandomPresets(juce::Random& random)
+    {
+        std::vector<PresetBank::Preset> presets(16);
+
+        for (auto& preset : presets)
+        {
+            auto& state = preset.state;
+            state.speed = random.nextFloat();
+            state.sync = random.nextBool();
+            state.dot = random.nextBool();
+            state.trip = random.nextBool();
+            state.quantizeToBar = random.nextBool();
+            state.seed = (juce::uint32)random.nextInt();
+            state.swing = 50.0f + 25.0f * random.nextFloat();
+
+            for (auto& o : state.orbits)
+            {
+                o.stepCount = 1 + random.nextInt(EuclideanPattern::maxSteps);
+                o.pulseCount = random.nextInt(o.stepCount + 1);
+                o.rotation = random.nextInt(o.stepCount);
+                o.clockRate = random.nextInt(11);
+                o.outputNote = random.nextInt(12);
+                o.octave = random.nextInt(11) - 5;
+                o.channel = 1 + random.nextInt(inputChannel - 1);
+            }
+        }
+
+        return presets;
+    }
+
+    void changeSomething(ProcessorHarness& harness, juce::Random& random)
+    {
+        auto& processor = harness.processor;
+        auto orbit = random.nextInt(numOrbits);
+        auto step = random.nextInt(EuclideanPattern::maxSteps);
+
+        switch (random.nextInt(12))
+        {
+            case 0:     processor.setStepVelocity(orbit, step, random.nextInt(128)); break;
+            case 1:     processor.setStepProbability(orbit, step, random.nextInt(101)); break;
+            case 2:     processor.setStepRatchet(orbit, step, 1 + random.nextInt(8)); break;
+            case 3:     processor.setRandomSeed((juce::uint32)random.nextInt()); break;
+            case 4:     harness.setParameter("Channel" + juce::String(orbit + 1), (float)(1 + random.nextInt(inputChannel - 1))); break;
+
+            case 5:
+            {
+                Groove::Template groove;
+
+                if (random.nextBool())
+                {
+                    groove.length = 1 + random.nextInt(Groove::maxLength);
+
+                    for (auto& offset : groove.offsets)
+                        offset = (random.nextFloat() * 2.0f - 1.0f) * Groove::maxOffset;
+                }
+
+                processor.setGrooveTemplate(groove);
+                break;
+            }
+
+            case 6:
+            {
+                juce::MemoryBlock state;
+                processor.getStateInformation(state);
+                processor.setStateInformation(state.getData(), (int)state.getSize());
+                break;
+            }
+
+            case 7:
+                if (random.nextInt(8) == 0)
+                    processor.setCurrentProgram(random.nextInt(processor.getNumPrograms()));
+                break;
+
+            default:
+            {
+                // any parameter but the channels, which keep the orbits off the input channel
+                auto& parameters = processor.getParameters();
+                auto* parameter = dynamic_cast<juce::RangedAudioParameter*>(parameters[random.nextInt(parameters.size())]);
+
+                if (parameter != nullptr && ! parameter->paramID.startsWith("Channel"))
+                    parameter->setValueNotifyingHost(random.nextFloat());
+
+                break;
+            }
+        }
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    auto minutes = argc > 1 ? juce::jmax(0.01, juce::String(argv[1]).getDoubleValue()) : 2.0;
+    auto seed = argc > 2 ? juce::String(argv[2]).getLargeIntValue() : juce::Time::currentTimeMillis();
+    std::cout << "soaking for " << minutes << " minutes, seed " << seed << std::endl;
+
+    juce::Random bankRandom(seed + 2);
+    juce::TemporaryFile bank(".eucb");
+    PresetBank::write(bank.getFile(), makeRandomPresets(bankRandom));
+
+    ProcessorHarness harness(bank.getFile());
+    Receiver receiver;
+
+    for (int i = 0; i < numOrbits; i++)
+    {
+        harness.setOrbit(i, true, 5 + 3 * i, 2 + i, (2 + 2 * i) % 11);
+        harness.setParameter("Channel" + juce::String(i + 1), (float)(1 + i));
+    }
+
+    harness.prepare(48000.0, maxBlockSize);
+    harness.settle();
+
+    std::atomic<bool> running { true };
+    juce::Random audioRandom(seed);
+
+    std::thread audioThread([&]
+    {
+        std::vector<RenderedEvent> events;
+        events.reserve(4096);
+
+        while (running.load())
+            renderRandomBlock(harness, audioRandom, receiver, events);
+    });
+
+    juce::Random messageRandom(seed + 1);
+    auto end = juce::Time::getMillisecondCounterHiRes() + minutes * 60000.0;
+
+    while (juce::Time::getMillisecondCounterHiRes() < end)
+    {
+        for (auto n = messageRandom.nextInt(4); --n >= 0;)
+            changeSomething(harness, messageRandom);
+
+        harness.settle(1 + messageRandom.nextInt(30));
+    }
+
+    running.store(false);
+    audioThread.join();
+
+    // programs still queued take over first, one a step or bar, each with its own Sync, and then the parameters
+    // they were copied into. with the transport stopped synced ones do so straight away, a free-running bar
+    // takes a few seconds at most, so a full queue is through in five minutes
+    std::vector<RenderedEvent> events;
+    harness.setPlaying(false);
+
+    for (int i = 0; i < 30; i++)
+    {
+        auto drained = harness.getPosition();
+        events.clear();
+        harness.render(10 * (juce::int64)harness.getSampleRate(), 512, &events);
+        receiver.check(events, drained, harness.getPosition());
+        harness.settle();
+    }
+
+    // play on with the host in charge, then stop: everything still sounding must be let go
+    harness.setParameter("Sync", 1.0f);
+    harness.settle();
+
+    harness.playHead.hasPosition = true;
+    harness.setPlaying(true);
+    events.clear();
+    harness.render((juce::int64)harness.getSampleRate(), 512, &events);
+    receiver.check(events, harness.getPosition() - (juce::int64)harness.getSampleRate(), harness.getPosition());
+
+    harness.setPlaying(false);
+    events.clear();
+    auto stopped = harness.getPosition();
+    harness.render(512, 512, &events);
+    receiver.check(events, stopped, harness.getPosition());
+
+    if (auto stuck = receiver.countSounding())
+    {
+        std::cout << "FAILED: " << stuck << " notes left sounding after the transport stopped" << std::endl;
+        receiver.numFailures++;
+    }
+
+    auto& statistics = harness.processor.statistics;
+
+   #if EUCLID_REALTIME_AUDIT
+    if (statistics.getAllocationCount() + statistics.getFreeCount() + statistics.getLockCount() > 0)
+    {
+        std::cout << "FAILED: " << statistics.getAllocationCount() << " allocations, " << statistics.getFreeCount()
+                  << " frees and " << statistics.getLockCount() << " locks inside processBlock" << std::endl;
+        receiver.numFailures++;
+    }
+   #endif
+
+    std::cout << receiver.numNotes << " notes, " << statistics.toString() << std::endl;
+
+    if (receiver.numFailures > 0)
+    {
+        std::cout << receiver.numFailures << " failures" << std::endl;
+        return 1;
+    }
+
+    std::cout << "passed" << std::endl;
+    return 0;
+}
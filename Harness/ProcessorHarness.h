@@ -0,0 +1,242 @@
+/*
+  ==============================================================================
+
+    Drives the processor the way a host would, without one, collecting
+    what it emits at absolute sample times. Shared by the bench, the tests
+    and the soak run; needs a message manager for the processor's timer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+// a host transport that only moves when told to
+struct FakePlayHead : public juce::AudioPlayHead
+{
+    FakePlayHead()
+    {
+        info.resetToDefault();
+        info.bpm = 120.0;
+        info.timeSigNumerator = 4;
+        info.timeSigDenominator = 4;
+        info.isPlaying = true;
+    }
+
+    bool getCurrentPosition(CurrentPositionInfo& result) override
+    {
+        result = info;
+        return hasPosition;
+    }
+
+    CurrentPositionInfo info;
+    bool hasPosition = true;
+};
+
+//==============================================================================
+// one short message the processor emitted, at its sample counted from the start of the run
+struct RenderedEvent
+{
+    juce::int64 time = 0;
+    int numBytes = 0;
+    std::array<juce::uint8, 3> bytes {};
+
+    bool isNoteOn() const noexcept   { return numBytes == 3 && (bytes[0] & 0xf0) == 0x90 && bytes[2] > 0; }
+    bool isNoteOff() const noexcept  { return numBytes == 3 && ((bytes[0] & 0xf0) == 0x80 || ((bytes[0] & 0xf0) == 0x90 && bytes[2] == 0)); }
+
+    bool operator==(const RenderedEvent& other) const noexcept
+    {
+        return time == other.time && numBytes == other.numBytes && bytes == other.bytes;
+    }
+
+    bool operator!=(const RenderedEvent& other) const noexcept  { return ! operator==(other); }
+
+    juce::String toString() const
+    {
+        juce::String s(time);
+
+        for (int i = 0; i < numBytes; i++)
+            s << " " << juce::String::toHexString((int)bytes[(size_t)i]).paddedLeft('0', 2);
+
+        return s;
+    }
+};
+
+//==============================================================================
+class ProcessorHarness
+{
+public:
+    // without a bank of its own the processor has no presets, so nothing run here touches the user's
+    explicit ProcessorHarness(const juce::File& presetFile = {})
+        : processor(presetFile)
+    {
+        processor.setPlayHead(&playHead);
+    }
+
+    ~ProcessorHarness()
+    {
+        processor.releaseResources();
+        processor.setPlayHead(nullptr);
+    }
+
+    // restarts the run at sample 0 and ppq 0
+    void prepare(double newSampleRate, int newMaxBlockSize)
+    {
+        sampleRate = newSampleRate;
+        maxBlockSize = newMaxBlockSize;
+
+        processor.setRateAndBufferSizeDetails(sampleRate, maxBlockSize);
+        processor.prepareToPlay(sampleRate, maxBlockSize);
+        processor.statistics.reset();
+
+        // the processor swaps its output in, this side needs the same room so neither ever grows
+        buffer.setSize(0, maxBlockSize);
+        midi.ensureSize(NewProjectAudioProcessor::outputMidiBytes);
+
+        position = 0;
+        originSample = 0;
+        originPpq = 0.0;
+        input.clear();
+        nextInput = 0;
+    }
+
+    //==============================================================================
+    void setParameter(const juce::String& id, float value)
+    {
+        if (auto* p = processor.treeState.getParameter(id))
+            p->setValueNotifyingHost(p->convertTo0to1(value));
+    }
+
+    void setOrbit(int orbit, bool on, int steps, int pulses, int clockRate = 5)
+    {
+        auto id = juce::String(orbit + 1);
+        setParameter("bOnButton" + id, on ? 1.0f : 0.0f);
+        setParameter("StepCount" + id, (float)steps);
+        setParameter("PulseCount" + id, (float)pulses);
+        setParameter("ClockRate" + id, (float)clockRate);
+    }
+
+    // runs the message loop long enough for the processor's timer to publish whatever changed
+    void settle(int milliseconds = 100)
+    {
+        juce::MessageManager::getInstance()->runDispatchLoopUntil(milliseconds);
+    }
+
+    //==============================================================================
+    // the transport carries on from where it is, so ppq stays continuous across changes
+    void setTempo(double bpm)
+    {
+        relocate(getPpqAt(position));
+        playHead.info.bpm = bpm;
+    }
+
+    void setPlaying(bool shouldPlay)
+    {
+        relocate(getPpqAt(position));
+        playHead.info.isPlaying = shouldPlay;
+    }
+
+    // the host jumps: the next block starts at 'ppq'
+    void relocate(double ppq)
+    {
+        originPpq = ppq;
+        originSample = position;
+    }
+
+    double getPpqAt(juce::int64 sample) const
+    {
+        if (! playHead.info.isPlaying)
+            return originPpq;
+
+        return originPpq + (double)(sample - originSample) * playHead.info.bpm / (60.0 * sampleRate);
+    }
+
+    juce::int64 getPosition() const noexcept    { return position; }
+    double getSampleRate() const noexcept       { return sampleRate; }
+
+    //==============================================================================
+    // queues a message to reach the processor at an absolute sample, which mustn't be in the past
+    void addInput(juce::int64 time, const juce::MidiMessage& message)
+    {
+        jassert(time >= position && message.getRawDataSize() <= 3);
+
+        RenderedEvent e;
+        e.time = time;
+        e.numBytes = message.getRawDataSize();
+        std::copy(message.getRawData(), message.getRawData() + e.numBytes, e.bytes.begin());
+
+        auto at = std::upper_bound(input.begin() + (long)nextInput, input.end(), e,
+                                   [](const RenderedEvent& a, const RenderedEvent& b) { return a.time < b.time; });
+        input.insert(at, e);
+    }
+
+    // renders 'numSamples' in blocks of at most 'blockSize', appending what comes out to 'events'
+    void render(juce::int64 numSamples, int blockSize, std::vector<RenderedEvent>* events = nullptr)
+    {
+        for (juce::int64 done = 0; done < numSamples;)
+        {
+            auto n = (int)juce::jmin((juce::int64)blockSize, numSamples - done);
+            processBlock(n, events);
+            done += n;
+        }
+    }
+
+    void processBlock(int numSamples, std::vector<RenderedEvent>* events = nullptr)
+    {
+        jassert(numSamples > 0 && numSamples <= maxBlockSize);
+
+        buffer.setSize(0, numSamples, false, false, true);
+        midi.clear();
+
+        for (; nextInput < input.size() && input[nextInput].time < position + numSamples; nextInput++)
+        {
+            auto& e = input[nextInput];
+            midi.addEvent(e.bytes.data(), e.numBytes, (int)(e.time - position));
+        }
+
+        auto& info = playHead.info;
+        info.timeInSamples = position;
+        info.timeInSeconds = (double)position / sampleRate;
+        info.ppqPosition = getPpqAt(position);
+
+        processor.processBlock(buffer, midi);
+
+        if (events != nullptr)
+        {
+            for (const auto metadata : midi)
+            {
+                RenderedEvent e;
+                e.time = position + metadata.samplePosition;
+                e.numBytes = juce::jmin(3, metadata.numBytes);
+                std::copy(metadata.data, metadata.data + e.numBytes, e.bytes.begin());
+                events->push_back(e);
+            }
+        }
+
+        position += numSamples;
+    }
+
+    //==============================================================================
+    NewProjectAudioProcessor processor;
+    FakePlayHead playHead;
+
+private:
+    double sampleRate = 44100.0;
+    int maxBlockSize = 512;
+
+    juce::AudioBuffer<float> buffer;
+    juce::MidiBuffer midi;
+    juce::int64 position = 0;
+
+    // the transport is at originPpq at originSample and moves on at the play head's tempo from there
+    juce::int64 originSample = 0;
+    double originPpq = 0.0;
+
+    std::vector<RenderedEvent> input;
+    size_t nextInput = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(ProcessorHarness)
+};
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    Incoming MIDI held back until the notes it came in with are played.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SequencerConfig.h"
+
+//==============================================================================
+/**
+    While the output runs the lookahead late, input passed through is held
+    here for the same time so it stays in time with the notes. It comes in
+    in time order, so a fixed ring of messages is all it takes, kept apart
+    from the notes so a dense controller stream can never take their room.
+    When the ring is full the oldest message goes early.
+*/
+class MidiDelayLine
+{
+public:
+    static constexpr int capacity = maxDelayedMessages;
+
+    MidiDelayLine() = default;
+
+    //==============================================================================
+    // holds a message of up to three bytes until absolute sample 'time'. when full, the oldest is sent at 'offset'
+    void push(juce::MidiBuffer& midi, int offset, juce::int64 time, const juce::uint8* data, int numBytes) noexcept
+    {
+        jassert (numBytes > 0 && numBytes <= 3);
+
+        if (numMessages == capacity)
+            send(midi, offset);
+
+        auto& m = messages[(size_t)((first + numMessages++) % capacity)];
+        m.time = time;
+        m.size = juce::jlimit(1, 3, numBytes);
+        std::copy(data, data + m.size, m.bytes.begin());
+    }
+
+    // sends everything due before absolute sample 'until'. anything already overdue goes at the block's first sample
+    void dispatchUntil(juce::MidiBuffer& midi, juce::int64 blockStart, juce::int64 until) noexcept
+    {
+        while (numMessages > 0 && messages[(size_t)first].time < until)
+            send(midi, (int)juce::jmax((juce::int64)0, messages[(size_t)first].time - blockStart));
+    }
+
+    // forgets everything without sending anything, for when playback restarts
+    void reset() noexcept
+    {
+        first = 0;
+        numMessages = 0;
+    }
+
+    int size() const noexcept   { return numMessages; }
+
+private:
+    struct Message
+    {
+        juce::int64 time;
+        std::array<juce::uint8, 3> bytes;
+        int size;
+    };
+
+    void send(juce::MidiBuffer& midi, int offset) noexcept
+    {
+        auto& m = messages[(size_t)first];
+        midi.addEvent(m.bytes.data(), m.size, offset);
+        first = (first + 1) % capacity;
+        numMessages--;
+    }
+
+    std::array<Message, capacity> messages {};
+    int first = 0, numMessages = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(MidiDelayLine)
+};
@@ -0,0 +1,155 @@
+/*
+  ==============================================================================
+
+    Note-offs waiting to be sent, kept in time order across blocks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SequencerConfig.h"
+
+//==============================================================================
+/**
+    Every note the sequencer starts books its note-off here at an absolute
+    sample time, however many blocks away that is, and notes that start
+    later in a step (ratchets) are booked the same way. Bookings live in a
+    fixed-capacity binary min-heap, so booking and sending never allocates
+    and only the soonest booking is ever looked at.
+
+    Notes are counted per channel and pitch. Starting a pitch that is
+    already sounding sends a note-off first, so a receiver sees every
+    note-on matched by one note-off, and only the last booking for the pitch
+    sends its note-off, so orbits sharing a pitch can't cut each other short.
+*/
+class NoteScheduler
+{
+public:
+    static constexpr int capacity = maxVoices;
+
+    NoteScheduler() = default;
+
+    //==============================================================================
+    // plays a note at 'offset' into a block starting at absolute sample 'blockStart', to be released
+    // 'length' samples later. at capacity, the booking due soonest makes room: its note ends here,
+    // or if it's a note that hasn't started yet, it never does
+    void play(juce::MidiBuffer& midi, juce::int64 blockStart, int offset, int channel, int note,
+              juce::uint8 velocity, juce::int64 length) noexcept
+    {
+        if (numPending == capacity)
+            makeRoom(midi, offset);
+
+        auto& count = sounding[index(channel, note)];
+
+        if (count > 0)
+            midi.addEvent(juce::MidiMessage::noteOff(channel, note), offset);
+
+        midi.addEvent(juce::MidiMessage::noteOn(channel, note, velocity), offset);
+        count++;
+
+        book({ blockStart + offset + juce::jmax((juce::int64)1, length), 0, (juce::uint8)channel, (juce::uint8)note, 0 });
+    }
+
+    // books a note to start at absolute sample 'start'. at capacity the soonest booking makes room as in play(),
+    // anything it sends going at 'offset' into 'midi'
+    void playLater(juce::MidiBuffer& midi, int offset, juce::int64 start, int channel, int note,
+                   juce::uint8 velocity, juce::int64 length) noexcept
+    {
+        if (numPending == capacity)
+            makeRoom(midi, offset);
+
+        book({ start, juce::jmax((juce::int64)1, length), (juce::uint8)channel, (juce::uint8)note, velocity });
+    }
+
+    // sends everything due before absolute sample 'until'. anything already overdue goes at the block's first sample.
+    // called up to and including a step's sample before the step plays, so notes ending there end before new ones start
+    void dispatchUntil(juce::MidiBuffer& midi, juce::int64 blockStart, juce::int64 until) noexcept
+    {
+        while (numPending > 0 && pending[0].time < until)
+            dispatchNext(midi, blockStart, (int)juce::jmax((juce::int64)0, pending[0].time - blockStart));
+    }
+
+    // sends every note-off still pending at 'offset', notes that haven't started yet are dropped
+    void releaseAll(juce::MidiBuffer& midi, int offset) noexcept
+    {
+        while (numPending > 0)
+            cancel(midi, pop(), offset);
+    }
+
+    // forgets everything without sending anything, for when playback restarts
+    void reset() noexcept
+    {
+        numPending = 0;
+        sounding.fill(0);
+    }
+
+    int size() const noexcept   { return numPending; }
+
+private:
+    struct Pending
+    {
+        juce::int64 time;
+        juce::int64 length;     // for a note still to start, how long it lasts. 0 for a note-off
+        juce::uint8 channel;
+        juce::uint8 note;
+        juce::uint8 velocity;
+    };
+
+    // soonest first, and note-offs before note-ons due on the same sample
+    static bool later(const Pending& a, const Pending& b) noexcept
+    {
+        return a.time != b.time ? a.time > b.time : (a.length != 0 && b.length == 0);
+    }
+
+    static size_t index(int channel, int note) noexcept     { return (size_t)(((channel - 1) & 15) * 128 + (note & 127)); }
+
+    void book(const Pending& p) noexcept
+    {
+        pending[(size_t)numPending++] = p;
+        std::push_heap(pending.begin(), pending.begin() + numPending, later);
+    }
+
+    Pending pop() noexcept
+    {
+        std::pop_heap(pending.begin(), pending.begin() + numPending, later);
+        return pending[(size_t)--numPending];
+    }
+
+    void dispatchNext(juce::MidiBuffer& midi, juce::int64 blockStart, int offset) noexcept
+    {
+        auto p = pop();
+
+        if (p.length != 0)
+            play(midi, blockStart, offset, p.channel, p.note, p.velocity, p.length);
+        else
+            cancel(midi, p, offset);
+    }
+
+    // the booking due soonest goes now: a note-off is sent early, a note that hasn't started never does
+    void makeRoom(juce::MidiBuffer& midi, int offset) noexcept
+    {
+        cancel(midi, pop(), offset);
+    }
+
+    void cancel(juce::MidiBuffer& midi, const Pending& p, int offset) noexcept
+    {
+        if (p.length == 0)
+            release(midi, p.channel, p.note, offset);
+    }
+
+    void release(juce::MidiBuffer& midi, int channel, int note, int offset) noexcept
+    {
+        auto& count = sounding[index(channel, note)];
+
+        if (count > 0 && --count == 0)
+            midi.addEvent(juce::MidiMessage::noteOff(channel, note), offset);
+    }
+
+    std::array<Pending, capacity> pending {};
+    int numPending = 0;
+    std::array<juce::uint16, 16 * 128> sounding {};  // bookings per channel and pitch
+
+    JUCE_DECLARE_NON_COPYABLE(NoteScheduler)
+};
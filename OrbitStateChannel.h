@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    Lock-free hand-off of the sequencer's playback state from the audio
+    thread to the editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SequencerConfig.h"
+
+//==============================================================================
+/**
+    Wait-free single-producer/single-consumer channel for a small, trivially
+    copyable value (a triple buffer).
+
+    The producer always owns one slot, the consumer owns another and the third
+    sits in the middle. Publishing swaps the producer's slot into the middle,
+    reading swaps the middle out to the consumer, so neither side ever blocks
+    or sees a half-written value. Only the most recent write is kept.
+*/
+template <typename ValueType>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    // producer side (audio thread)
+    void write(const ValueType& value) noexcept
+    {
+        slots[backIndex] = value;
+        backIndex = middle.exchange(backIndex | dirtyBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // consumer side (message thread), returns false if nothing new was published since the last read
+    bool read(ValueType& dest) noexcept
+    {
+        if ((middle.load(std::memory_order_relaxed) & dirtyBit) == 0)
+            return false;
+
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+        dest = slots[frontIndex];
+        return true;
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<ValueType>::value, "TripleBuffer values are copied bytewise");
+
+    static constexpr int indexMask = 3;
+    static constexpr int dirtyBit = 4;
+
+    ValueType slots[3] {};
+    std::atomic<int> middle { 1 };
+    int backIndex = 0;  // only touched by the producer
+    int frontIndex = 2; // only touched by the consumer
+
+    JUCE_DECLARE_NON_COPYABLE(TripleBuffer)
+};
+
+//==============================================================================
+/** What the orbit display needs from the audio thread after each step. */
+struct OrbitDisplayState
+{
+    std::array<int, numOrbits> currentStep {};
+    juce::uint32 pulseActive = 0; // bit i is set while orbit i sits on a pulse
+};
@@ -0,0 +1,165 @@
+/*
+  ==============================================================================
+
+    Offline rendering of the current pattern to a Standard MIDI File.
+
+  ==============================================================================
+*/
+
+#include "PatternExport.h"
+#include "NoteScheduler.h"
+
+#include <map>
+
+juce::MidiFile PatternExport::render(const Settings& settings)
+{
+    auto& layout = settings.layout;
+    auto singleTrack = settings.midiFileType == 0;
+    auto quartersPerTick = settings.stepQuarters / EventTimeline::ticksPerStep;
+    auto fileTicksPerTick = quartersPerTick * ticksPerQuarterNote;
+    auto fileTicksPerMs = settings.bpm / 60.0 * ticksPerQuarterNote * 0.001;
+    auto totalQuarters = (4.0 * settings.numerator / settings.denominator) * juce::jmax(0, settings.numBars);
+    auto end = (juce::int64)std::round(totalQuarters * ticksPerQuarterNote);
+
+    // the groove moves notes as processBlock does. everything is played the lookahead late there and the host
+    // takes that back off, so here it's booked late the same way and taken off again at the end
+    auto lookahead = (juce::int64)std::round(settings.lookaheadMs * fileTicksPerMs);
+    auto groove = Groove::scale(settings.groove, EventTimeline::ticksPerStep * fileTicksPerTick, (double)lookahead);
+
+    // notes go through the scheduler processBlock plays them through, counting file ticks instead of samples,
+    // so the file has the same voice limit and the same note-off before a pitch that's sounding starts again.
+    // which orbit booked each note-on is remembered to put it on that orbit's track
+    NoteScheduler scheduler;
+    juce::MidiBuffer played;
+    std::multimap<std::tuple<juce::int64, int, int>, int> bookedBy;    // (time played, channel, note) -> orbit
+
+    auto book = [&](int orbit, juce::int64 now, juce::int64 start, juce::uint8 velocity, juce::int64 gate)
+    {
+        auto& o = layout[orbit];
+
+        if (start == now)
+            scheduler.play(played, 0, (int)start, o.channel, o.note, velocity, gate);
+        else
+            scheduler.playLater(played, (int)now, start, o.channel, o.note, velocity, gate);
+
+        if (! singleTrack)
+            bookedBy.insert({ { start, o.channel, o.note }, orbit });
+    };
+
+    juce::uint64 tick = 0;
+
+    while ((double)tick * quartersPerTick < totalQuarters)
+    {
+        juce::uint32 stepping = 0;
+        auto next = std::numeric_limits<juce::uint64>::max();
+
+        for (int i = 0; i < numOrbits; i++)
+        {
+            auto stepTicks = (juce::uint64)layout[i].stepTicks;
+            stepping |= (juce::uint32)(tick % stepTicks == 0) << i;
+            next = juce::jmin(next, (tick / stepTicks + 1) * stepTicks);
+        }
+
+        auto now = (juce::int64)std::round((double)tick * fileTicksPerTick);
+        scheduler.dispatchUntil(played, 0, now + 1);
+
+        for (auto bits = stepping; bits != 0; bits &= bits - 1)
+        {
+            auto i = countTrailingZeros(bits);
+            auto& o = layout[i];
+            auto notes = EventTimeline::notesAt(o, settings.rotation[i], EventTimeline::stepAt(o, tick), tick,
+                                                o.stepTicks * fileTicksPerTick, fileTicksPerMs);
+
+            if (notes.repeats == 0)
+                continue;
+
+            auto delay = (juce::int64)std::round((double)lookahead + Groove::offsetAt(groove, (juce::int64)tick, EventTimeline::ticksPerStep));
+            auto start = now + juce::jmax((juce::int64)0, delay);
+            auto gate = (juce::int64)std::round(notes.gateLength);
+
+            for (int r = 0; r < notes.repeats; r++)
+                book(i, now, start + (juce::int64)std::round(r * notes.repeatLength), notes.velocity, gate);
+        }
+
+        tick = next;
+    }
+
+    // notes still held when the export ends are cut at the last bar line, ones that haven't started are dropped
+    scheduler.dispatchUntil(played, 0, end + lookahead);
+    scheduler.releaseAll(played, (int)(end + lookahead));
+
+    juce::MidiMessageSequence tracks[numOrbits];
+    std::array<std::array<int, 128>, 16> startedBy {};     // the orbit whose note a sounding pitch is
+
+    if (! singleTrack)
+        for (int i = 0; i < numOrbits; i++)
+            tracks[i].addEvent(juce::MidiMessage::textMetaEvent(3, "Orbit " + juce::String(i + 1)));
+
+    for (const auto metadata : played)
+    {
+        juce::MidiMessage message(metadata.data, metadata.numBytes, (double)juce::jmax(0, metadata.samplePosition - (int)lookahead));
+        auto orbit = 0;
+
+        if (! singleTrack)
+        {
+            auto& owner = startedBy[(size_t)(message.getChannel() - 1)][(size_t)message.getNoteNumber()];
+            auto booking = bookedBy.find({ (juce::int64)metadata.samplePosition, message.getChannel(), message.getNoteNumber() });
+
+            if (message.isNoteOn() && booking != bookedBy.end())
+            {
+                owner = booking->second;
+                bookedBy.erase(booking);
+            }
+
+            orbit = owner;
+        }
+
+        tracks[orbit].addEvent(message);
+    }
+
+    juce::MidiMessageSequence conductor;
+    conductor.addEvent(juce::MidiMessage::tempoMetaEvent(juce::roundToInt(60000000.0 / settings.bpm)));
+    conductor.addEvent(juce::MidiMessage::timeSignatureMetaEvent(settings.numerator, settings.denominator));
+
+    juce::MidiFile file;
+    file.setTicksPerQuarterNote(ticksPerQuarterNote);
+
+    if (singleTrack)
+    {
+        conductor.addSequence(tracks[0], 0.0);
+        conductor.updateMatchedPairs();
+        file.addTrack(conductor);
+    }
+    else
+    {
+        file.addTrack(conductor);
+
+        for (int i = 0; i < numOrbits; i++)
+        {
+            tracks[i].updateMatchedPairs();
+            file.addTrack(tracks[i]);
+        }
+    }
+
+    return file;
+}
+
+bool PatternExport::write(const Settings& settings, juce::OutputStream& destination)
+{
+    return render(settings).writeTo(destination, settings.midiFileType == 0 ? 0 : 1);
+}
+
+bool PatternExport::write(const Settings& settings, const juce::File& destination)
+{
+    // written next to the target first, so a failed export never leaves half a file behind
+    juce::TemporaryFile temp(destination);
+
+    {
+        juce::FileOutputStream out(temp.getFile());
+
+        if (! out.openedOk() || ! write(settings, out))
+            return false;
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
@@ -0,0 +1,39 @@
+/*
+  ==============================================================================
+
+    Offline rendering of the current pattern to a Standard MIDI File, on
+    the same tick grid and through the same scheduler as processBlock.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SequencerConfig.h"
+#include "EventTimeline.h"
+
+namespace PatternExport
+{
+    constexpr int ticksPerQuarterNote = 960;
+
+    struct Settings
+    {
+        std::array<EventTimeline::OrbitLayout, numOrbits> layout;
+        std::array<int, numOrbits> rotation {};
+        Groove::Template groove;
+        double lookaheadMs = 0.0;               // how early the groove may pull a step, as Lookahead does
+        double stepQuarters = 0.25;             // one global step, in quarter notes
+        double bpm = 120.0;
+        int numerator = 4, denominator = 4;
+        int numBars = 4;
+        int midiFileType = 1;                   // 0: a single track, 1: a tempo track plus one track per orbit
+    };
+
+    //==============================================================================
+    juce::MidiFile render(const Settings& settings);
+
+    // both return false if the file couldn't be written
+    bool write(const Settings& settings, juce::OutputStream& destination);
+    bool write(const Settings& settings, const juce::File& destination);
+}
@@ -1026,34 +1026,19 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParametersPanel)
 };
 //===============================================================================================================
-class VisualOrbit : public juce::Component,
-    private juce::AudioProcessorParameter::Listener
+class VisualOrbit : public juce::Component
 { 
 public:
-    VisualOrbit(NewProjectAudioProcessor& p,juce::AudioProcessorValueTreeState& t, juce::AudioProcessorParameter* stepParam, juce::AudioProcessorParameter* pulseParam,int i, juce::Colour c)
-        : processor(p),tree(t), stepParameter(*stepParam), pulseParameter(*pulseParam), index(i), color(c)
+    VisualOrbit(NewProjectAudioProcessor& p,juce::AudioProcessorValueTreeState& t, juce::AudioProcessorParameter* stepParam,int i, juce::Colour c)
+        : processor(p),tree(t), stepParameter(*stepParam), index(i), color(c)
     {      
-        stepParameter.addListener(this);
-        pulseParameter.addListener(this);
-        
         numSteps = stepParameter.getValue();
 
         auto myVariable = tree.getRawParameterValue("StepCount"+std::to_string(index+1));
         numSteps = *myVariable;
       
-        pulseActive = pulseParameter.getDefaultValue();
-
-        pulseIndex = pulseParameter.getParameterIndex();
-        stepIndex = stepParameter.getParameterIndex();
-
-
-
-    }
-
-    ~VisualOrbit() override
-    {
-        stepParameter.removeListener(this);
-        pulseParameter.removeListener(this);
+        pulseActive = true;
+        currentStep = 0;
     }
 
     void paint(juce::Graphics& g) override
@@ -1094,13 +1079,20 @@ public:
             g.fillEllipse(Rectangle<float>(dotW, dotW).withCentre(thumbPoint));
         }
 
+        // a tick across the ring marks the step the rotated pattern now starts on
+        auto startAngle = (2 * MathConstants<float>::pi / numSteps) * rotation - MathConstants<float>::halfPi;
+        Point<float> direction(std::cos(startAngle), std::sin(startAngle));
+        g.setColour(color);
+        g.drawLine(Line<float>(bounds.getCentre().toFloat() + direction * (arcRadius - lineW),
+                               bounds.getCentre().toFloat() + direction * (arcRadius + lineW)), 2.0f);
+
         auto thumbWidth = lineW * 1.5f;
         toAngle = (2 * MathConstants<float>::pi / numSteps) * currentStep;
         Point<float> thumbPoint(bounds.getCentreX() + arcRadius * std::cos(toAngle - MathConstants<float>::halfPi),
             bounds.getCentreY() + arcRadius * std::sin(toAngle - MathConstants<float>::halfPi));
 
         
-        g.setColour( (pulseParameter.getValue())? 
+        g.setColour( (pulseActive)? 
             color : juce::Colours::darkgrey);
         g.fillEllipse(Rectangle<float>(thumbWidth, thumbWidth).withCentre(thumbPoint));
 
@@ -1112,29 +1104,17 @@ public:
         auto area = getLocalBounds();
     }
 
-   
-    void parameterValueChanged(int i, float f ) override 
-    {
-        //MessageManagerLock mml(Thread::getCurrentThread());
-        if (i == stepIndex)
-        {
-            processor.cycleChanged = true;
-        } 
-    }
 
     void setStep()
     {   // thought I might need a MessageManagerLock, looks like we're good here... 
         numSteps = *tree.getRawParameterValue("StepCount"+std::to_string(index+1)); 
+        rotation = (int)(*tree.getRawParameterValue("Rotation"+std::to_string(index+1))) % juce::jmax(1, numSteps);
     }
 
-    void move(int i) 
+    void move(int i, bool pulse) 
     {
         currentStep = i;
-    }
-
-    void parameterGestureChanged(int i, bool b) override 
-    {
-        
+        pulseActive = pulse;
     }
 
 public:
@@ -1143,37 +1123,41 @@ public:
     int index;
     bool pulseActive;
     int numSteps, currentStep;
-    int stepIndex, pulseIndex;
+    int rotation = 0;
     juce::Colour color;
 
 private:
     NewProjectAudioProcessor& processor;
     juce::AudioProcessorValueTreeState& tree;
     juce::AudioProcessorParameter& stepParameter;
-    juce::AudioProcessorParameter& pulseParameter;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VisualOrbit)
 };
 //==============================================================================>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 class OrbitPanel :public juce::Component,
-    private juce::AudioProcessorParameter::Listener
+    private juce::Timer
 {
 public:
-    OrbitPanel(NewProjectAudioProcessor& proc, juce::AudioProcessorParameter* forceStepParam)
-        :processor(proc), step(*forceStepParam)
+    OrbitPanel(NewProjectAudioProcessor& proc)
+        :processor(proc)
     {
         setSize(200, 200);
-        step.addListener(this);
 
-        addOrbit( std::make_unique<VisualOrbit>(processor, processor.treeState, processor.treeState.getParameter("StepCount1"), processor.treeState.getParameter("PulseActive1"), 0, juce::Colours::white));
-        addOrbit( std::make_unique<VisualOrbit>(processor, processor.treeState, processor.treeState.getParameter("StepCount2"), processor.treeState.getParameter("PulseActive2"), 1, juce::Colours::limegreen));
-        addOrbit( std::make_unique<VisualOrbit>(processor, processor.treeState, processor.treeState.getParameter("StepCount3"), processor.treeState.getParameter("PulseActive3"), 2, juce::Colours::orange));
-        addOrbit( std::make_unique<VisualOrbit>(processor, processor.treeState, processor.treeState.getParameter("StepCount4"), processor.treeState.getParameter("PulseActive4"), 3, juce::Colours::magenta));
-        addOrbit( std::make_unique<VisualOrbit>(processor, processor.treeState, processor.treeState.getParameter("StepCount5"), processor.treeState.getParameter("PulseActive5"), 4, juce::Colours::cyan));
+        const juce::Colour palette[] { juce::Colours::white, juce::Colours::limegreen, juce::Colours::orange, juce::Colours::magenta, juce::Colours::cyan };
+
+        for (int i = 0; i < numOrbits; i++)
+        {
+            auto colour = (i < juce::numElementsInArray(palette)) ? palette[i]
+                                                                  : juce::Colour::fromHSV((float)i / (float)numOrbits, 0.7f, 1.0f, 1.0f);
+
+            addOrbit( std::make_unique<VisualOrbit>(processor, processor.treeState, processor.treeState.getParameter("StepCount" + std::to_string(i + 1)), i, colour));
+        }
       
-        
+        // the audio thread publishes its step position through processor.displayChannel, we just poll it
+        startTimerHz(60);
     }
     ~OrbitPanel()
     {
+        stopTimer();
         orbits.clear();
         removeAllChildren();
        
@@ -1194,11 +1178,12 @@ public:
             int spacing;
             switch (orbits.size())
             {
+                case 1: spacing = 0; break;
                 case 2: spacing = 50; break;
                 case 3: spacing = 25; break;
                 case 4: spacing = 18; break;
                 case 5: spacing = 15; break;
-                default: spacing = 0; break;
+                default: spacing = 60 / ((int)orbits.size() - 1); break; // more than 5 orbits squeeze into the same rings
             }
 
             for (int x = 0; x < orbits.size(); x++)
@@ -1213,9 +1198,6 @@ public:
         //addChildAndSetID(o,"orbit");
         VisualOrbit& o = *vo;
 
-        indexes.add(o.stepIndex);
-        indexes.add(o.stepIndex+1);
-
         addAndMakeVisible(o);
 
         orbits.push_back(std::move(vo));
@@ -1233,31 +1215,22 @@ public:
         orbits.erase(orbits.begin()+i);
     }
 
-    void sendCycleChanged()  // should only be pulseCount or stepCount
-    {
-        processor.cycleChanged = true;  
-    }
     
-    void parameterValueChanged(int i, float f) override
+    void timerCallback() override
     {
-       
-        MessageManagerLock mml(Thread::getCurrentThread());
-        {  
+        OrbitDisplayState state;
+
+        if (processor.displayChannel.read(state))
+        {
             for (int x = 0; x < orbits.size(); x++)
-            {
-                orbits[x]->move(processor.currentStep[x]);
-                repaint();
-            }
+                orbits[x]->move(state.currentStep[x], (state.pulseActive >> x) & 1);
+
+            repaint();
         }
     }
 
-    void parameterGestureChanged(int i, bool b)
-    {
-    }
 public:
-    juce::SortedSet<int> indexes; 
     std::vector<std::unique_ptr<VisualOrbit>> orbits;
-    juce::AudioProcessorParameter& step;
     NewProjectAudioProcessor& processor;
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OrbitPanel)
@@ -1313,7 +1286,7 @@ struct AarrowAudioProcessorEditor::Pimpl
         //params.add(owner.audioProcessor.treeState.getParameter("bOnButton1"));
         //params.add(owner.audioProcessor.treeState.getParameter("Reversed1"));
 
-        clock = std::make_unique<OrbitPanel>(owner.audioProcessor, owner.audioProcessor.treeState.getParameter("ForceStep"));
+        clock = std::make_unique<OrbitPanel>(owner.audioProcessor);
 
        
  
@@ -1348,6 +1321,15 @@ struct AarrowAudioProcessorEditor::Pimpl
             .removeFromBottom(30)
             .translated(-50,-10));
 
+        exportButton.setTooltip("Render " + juce::String(exportBars) + " bars of the current pattern to a MIDI file");
+        exportButton.onClick = [this] { exportPattern(); };
+        fullPanel->addAndMakeVisible(exportButton);
+
+        exportButton.setBounds(fullPanel->getLocalBounds()
+            .removeFromLeft(130)
+            .removeFromTop(40)
+            .reduced(10, 5));
+
      
 
 
@@ -1368,6 +1350,23 @@ struct AarrowAudioProcessorEditor::Pimpl
         view.setViewedComponent(nullptr, false);
     }
 
+    void exportPattern()
+    {
+        exportChooser = std::make_unique<juce::FileChooser>("Export MIDI",
+            juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("Euclidean.mid"), "*.mid");
+
+        exportChooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                 | juce::FileBrowserComponent::warnAboutOverwriting,
+            [this](const juce::FileChooser& chooser)
+            {
+                auto file = chooser.getResult();
+
+                if (file != juce::File() && ! owner.audioProcessor.exportPattern(file, exportBars))
+                    juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Export MIDI",
+                                                           "Couldn't write " + file.getFullPathName());
+            });
+    }
+
     void resize(juce::Rectangle<int> size)
     {
         view.setBounds(size);
@@ -1387,6 +1386,9 @@ private:
     std::unique_ptr<OrbitPanel> clock;
     std::unique_ptr<ParametersPanel> myPanel;
     std::unique_ptr<ParametersPanel> controllerPanel;
+    static constexpr int exportBars = 4;
+    juce::TextButton exportButton { "EXPORT MIDI" };
+    std::unique_ptr<juce::FileChooser> exportChooser;
 public:
     juce::Viewport view;
     
@@ -9,8 +9,47 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+    // length of one step for each "ClockRate" choice (1/4 .. 4 times the global rate), in timeline ticks
+    constexpr int clockRateTicks[] { 48, 36, 24, 18, 16, 12, 9, 8, 6, 4, 3 };
+    constexpr int defaultClockRate = 5;
+
+    static_assert(clockRateTicks[defaultClockRate] == EventTimeline::ticksPerStep, "rate 1 should be one global step");
+
+    // a step computed to land within this much of a sample boundary counts as on it, so rounding in the
+    // host's ppq can't move it by a whole sample from one block size to another
+    constexpr double sampleTolerance = 1.0e-6;
+
+    // Speed reaches 2^89 bars a step with sync on, outside the range the editor offers. a step is kept
+    // short enough that note lengths in samples, ratchets and all, still fit in an int64
+    constexpr double maxStepQuarters = 4096.0;
+
+    // per-orbit parameters captured in the published pattern snapshot
+    const char* const timelineParameterIDs[] { "StepCount", "PulseCount", "Reversed", "ClockRate", "OutputNote", "iOctave", "Channel", "Gate" };
+
+    // the choice index is the semitone above C4, so the pitch is plain arithmetic on the raw values. each note
+    // goes up only as far as MIDI does: G9 is 127, so G# to B stop an octave lower rather than all becoming G
+    int noteNumber(int outputNote, int octave)
+    {
+        auto note = juce::jlimit(0, 11, outputNote);
+        return 60 + note + 12 * juce::jlimit(-5, (127 - 60 - note) / 12, octave);
+    }
+
+    // lanes as the editor can set them, whatever a saved state holds
+    void limitLanes(StateFormat::OrbitRecord& o)
+    {
+        for (int step = 0; step < EuclideanPattern::maxSteps; step++)
+        {
+            o.velocity[step] = (juce::uint8)juce::jlimit(1, 127, (int)o.velocity[step]);
+            o.probability[step] = juce::jmin(o.probability[step], StepLanes::alwaysPlays);
+            o.ratchet[step] = (juce::uint8)juce::jlimit(1, (int)StepLanes::maxRatchets, (int)o.ratchet[step]);
+        }
+    }
+}
+
 //==============================================================================
-NewProjectAudioProcessor::NewProjectAudioProcessor()
+NewProjectAudioProcessor::NewProjectAudioProcessor(const juce::File& bankFile)
 #ifndef JucePlugin_PreferredChannelConfigurations
     : AudioProcessor(BusesProperties()
 #if ! JucePlugin_IsMidiEffect
@@ -23,11 +62,30 @@ NewProjectAudioProcessor::NewProjectAudioProcessor()
 treeState(*this,nullptr,"PARAMETER_TREE",createParameterLayout())
 #endif 
 {
- 
+    resolveParameterHandles();
+    velocityLanes.fill(StepLanes::filled(StepLanes::defaultVelocity));
+    probabilityLanes.fill(StepLanes::filled(StepLanes::alwaysPlays));
+    ratchetLanes.fill(StepLanes::filled(1));
+
+    for (auto* p : getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(p))
+            treeState.addParameterListener(ranged->paramID, this);
+
+    presetFile = bankFile;
+    presets.open(presetFile);
+    publishPrograms();
+
+    rebuildTimeline(allOrbits);
+    startTimerHz(30);
 }
 
 NewProjectAudioProcessor::~NewProjectAudioProcessor()
 {
+    stopTimer();
+
+    for (auto* p : getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(p))
+            treeState.removeParameterListener(ranged->paramID, this);
 }
 
 //==============================================================================
@@ -42,24 +100,44 @@ juce::AudioProcessorValueTreeState::ParameterLayout NewProjectAudioProcessor::cr
     params.add(std::make_unique<juce::AudioParameterBool>("Dot", "DOT", true));
     params.add(std::make_unique<juce::AudioParameterBool>("Trip", "TRIP", false));
 
-    params.add(std::make_unique<juce::AudioParameterBool>("ForceStep", "STEP", false));
+    // where a pattern change lands: the next global step, or the next bar line
+    params.add(std::make_unique<juce::AudioParameterChoice>("Quantize", "QUANTIZE", juce::Array<juce::String>{ "Step", "Bar" }, 0));
+
+    // incoming midi: passed through with the orbits' notes, held notes taking over the orbits' pitches,
+    // note-ons restarting every orbit from its first step
+    params.add(std::make_unique<juce::AudioParameterBool>("MidiThru", "THRU", true));
+    params.add(std::make_unique<juce::AudioParameterBool>("FollowInput", "FOLLOW", false));
+    params.add(std::make_unique<juce::AudioParameterBool>("Retrigger", "RETRIGGER", false));
+
+    // swing, unless a groove template has been loaded, and how far ahead of the host notes are rendered
+    // so a groove can push them early. the lookahead is reported to the host as latency
+    params.add(std::make_unique<juce::AudioParameterFloat>("Swing", "SWING", 50.0f, 75.0f, 50.0f));
+    params.add(std::make_unique<juce::AudioParameterFloat>("Lookahead", "LOOKAHEAD", 0.0f, (float)maxLookaheadMs, 0.0f));
 
-    for (int i = 1; i < 6; i++)
+    for (int i = 1; i <= numOrbits; i++)
     {
         auto a = juce::String("OnButton"+ std::to_string(i));
      
         params.add(std::make_unique<juce::AudioParameterBool>(juce::String("bOnButton" + std::to_string(i)), juce::String("ON" + std::to_string(i)) ,false));
         params.add(std::make_unique<juce::AudioParameterBool>(juce::String("Reversed" + std::to_string(i)), juce::String("REVERSED" + std::to_string(i)), false));
 
-        params.add(std::make_unique<juce::AudioParameterBool>(juce::String("PulseActive" + std::to_string(i)), juce::String("PULSEON" + std::to_string(i)), true));
-        
-        // THESE TWO **MUST** BE IN THIS ORDER WITHOUT INTERRUPTION (PluginEditor.cpp :: OrbitPanel :: addOrbit)
         params.add(std::make_unique<juce::AudioParameterInt>(juce::String("StepCount" + std::to_string(i)), juce::String("STEPS" + std::to_string(i)), 1, 32, 8));
         params.add(std::make_unique<juce::AudioParameterInt>(juce::String("PulseCount" + std::to_string(i)),juce::String( "PULSES" + std::to_string(i)), 0, 32, 3));
+        // steps the pattern is moved round by, wrapped to the orbit's length
+        params.add(std::make_unique<juce::AudioParameterInt>(juce::String("Rotation" + std::to_string(i)), juce::String("ROTATION" + std::to_string(i)), 0, 31, 0));
 
-        params.add(std::make_unique<juce::AudioParameterChoice>(juce::String("OutputNote" + std::to_string(i)), juce::String("NOTE" + std::to_string(i)), juce::Array<juce::String>{ "C4", "C#4", "D4", "D#4", "E4", "F4", "F#4", "G4", "G#4", "A4", "A#4", "B4" },0));
+        params.add(std::make_unique<juce::AudioParameterChoice>(juce::String("OutputNote" + std::to_string(i)), juce::String("NOTE" + std::to_string(i)), juce::Array<juce::String>{ "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" },0));
         
-        params.add(std::make_unique<juce::AudioParameterInt>(juce::String("iOctave" + std::to_string(i)), juce::String("OCTAVE" + std::to_string(i)), -3, 3, 0));
+        // C4 shifted down as far as note 0 or up as far as 127
+        params.add(std::make_unique<juce::AudioParameterInt>(juce::String("iOctave" + std::to_string(i)), juce::String("OCTAVE" + std::to_string(i)), -5, 5, 0));
+        params.add(std::make_unique<juce::AudioParameterInt>(juce::String("Channel" + std::to_string(i)), juce::String("CHANNEL" + std::to_string(i)), 1, 16, 1));
+
+        // how long each note is held: a percentage of the orbit's step, or a fixed time
+        params.add(std::make_unique<juce::AudioParameterChoice>(juce::String("GateMode" + std::to_string(i)), juce::String("GATE MODE" + std::to_string(i)), juce::Array<juce::String>{ "% of step", "ms" }, 0));
+        params.add(std::make_unique<juce::AudioParameterInt>(juce::String("GateLength" + std::to_string(i)), juce::String("GATE" + std::to_string(i)), 1, 100, 100));
+        params.add(std::make_unique<juce::AudioParameterInt>(juce::String("GateTime" + std::to_string(i)), juce::String("GATE MS" + std::to_string(i)), 1, 2000, 250));
+
+        params.add(std::make_unique<juce::AudioParameterChoice>(juce::String("ClockRate" + std::to_string(i)), juce::String("RATE" + std::to_string(i)), juce::Array<juce::String>{ "1/4", "1/3", "1/2", "2/3", "3/4", "1", "4/3", "3/2", "2", "3", "4" }, defaultClockRate));
     }
         //params.push_back( std::make_unique<AudioParameterInt>(String(i), String(i), 0, i, 0) );
        
@@ -67,6 +145,247 @@ juce::AudioProcessorValueTreeState::ParameterLayout NewProjectAudioProcessor::cr
     return params;
 }
 
+void NewProjectAudioProcessor::resolveParameterHandles()
+{
+    speedParam = treeState.getRawParameterValue("Speed");
+    syncParam = treeState.getRawParameterValue("Sync");
+    dotParam = treeState.getRawParameterValue("Dot");
+    tripParam = treeState.getRawParameterValue("Trip");
+    quantizeParam = treeState.getRawParameterValue("Quantize");
+    thruParam = treeState.getRawParameterValue("MidiThru");
+    followParam = treeState.getRawParameterValue("FollowInput");
+    retriggerParam = treeState.getRawParameterValue("Retrigger");
+    swingParam = treeState.getRawParameterValue("Swing");
+    lookaheadParam = treeState.getRawParameterValue("Lookahead");
+
+    for (int i = 0; i < (int)orbitParams.size(); i++)
+    {
+        auto id = std::to_string(i + 1);
+        auto& o = orbitParams[i];
+
+        o.stepCount = treeState.getRawParameterValue("StepCount" + id);
+        o.pulseCount = treeState.getRawParameterValue("PulseCount" + id);
+        o.reversed = treeState.getRawParameterValue("Reversed" + id);
+        o.octave = treeState.getRawParameterValue("iOctave" + id);
+        o.clockRate = treeState.getRawParameterValue("ClockRate" + id);
+        o.onButton = treeState.getRawParameterValue("bOnButton" + id);
+        o.rotation = treeState.getRawParameterValue("Rotation" + id);
+        o.outputNote = treeState.getRawParameterValue("OutputNote" + id);
+        o.channel = treeState.getRawParameterValue("Channel" + id);
+        o.gateMode = treeState.getRawParameterValue("GateMode" + id);
+        o.gateLength = treeState.getRawParameterValue("GateLength" + id);
+        o.gateTime = treeState.getRawParameterValue("GateTime" + id);
+
+        jassert(o.stepCount != nullptr && o.pulseCount != nullptr && o.reversed != nullptr
+             && o.octave != nullptr && o.clockRate != nullptr && o.onButton != nullptr && o.rotation != nullptr
+             && o.outputNote != nullptr && o.channel != nullptr && o.gateMode != nullptr && o.gateLength != nullptr
+             && o.gateTime != nullptr);
+    }
+}
+
+// may be called from any thread, including the audio thread during automation
+void NewProjectAudioProcessor::parameterChanged(const juce::String& parameterID, float)
+{
+    stateGeneration.fetch_add(1, std::memory_order_release);
+
+    if (parameterID == "Swing")
+        grooveChanged = true;
+
+    // orbit parameter IDs end in the orbit's number
+    for (auto* id : timelineParameterIDs)
+    {
+        if (parameterID.startsWith(id))
+        {
+            auto orbit = parameterID.getTrailingIntValue() - 1;
+
+            if (juce::isPositiveAndBelow(orbit, numOrbits))
+                dirtyOrbits.fetch_or(1u << orbit);
+        }
+    }
+}
+
+void NewProjectAudioProcessor::timerCallback()
+{
+    // a program the audio thread has switched to is copied into the parameters, so the host and the editor
+    // show it and the timelines built from here on carry on from it. only the last of several is needed
+    auto switched = switchedProgram.load();
+
+    if ((juce::uint32)(switched >> 32) != appliedProgramSequence)
+    {
+        appliedProgramSequence = (juce::uint32)(switched >> 32);
+        loadProgram((int)(switched & 0xffffffffu));
+    }
+
+    auto dirty = dirtyOrbits.exchange(0);
+
+    if (grooveChanged.exchange(false) || dirty != 0)
+        rebuildTimeline(dirty);
+
+    updateLatency();
+}
+
+void NewProjectAudioProcessor::rebuildTimeline(juce::uint32 dirty)
+{
+    // only orbits whose parameters changed are looked up again, the merged cycle is always rebuilt whole
+    for (int i = 0; i < numOrbits; i++)
+        if (dirty & (1u << i))
+            orbitLayout[i] = makeOrbitLayout(i);
+
+    auto& timeline = timelines.beginWrite();
+    timeline.build(orbitLayout);
+    timeline.groove = currentGroove();
+    timeline.programSequence = appliedProgramSequence;
+    timelines.publish();
+}
+
+Groove::Template NewProjectAudioProcessor::currentGroove() const
+{
+    return customGroove.length > 0 ? customGroove : Groove::swing(*swingParam);
+}
+
+// the lookahead only changes the host's latency compensation when it's moved by a whole sample
+void NewProjectAudioProcessor::updateLatency()
+{
+    auto samples = juce::roundToInt(*lookaheadParam * 0.001 * getSampleRate());
+
+    if (samples != lookaheadSamples.load())
+    {
+        lookaheadSamples = samples;
+        setLatencySamples(samples);
+    }
+}
+
+void NewProjectAudioProcessor::setGrooveTemplate(const Groove::Template& groove)
+{
+    customGroove = groove;
+    customGroove.length = juce::jlimit(0, Groove::maxLength, customGroove.length);
+
+    for (auto& offset : customGroove.offsets)
+        offset = juce::jlimit(-Groove::maxOffset, Groove::maxOffset, offset);
+
+    grooveChanged = true;
+    stateGeneration.fetch_add(1, std::memory_order_release);
+}
+
+EventTimeline::OrbitLayout NewProjectAudioProcessor::makeOrbitLayout(int orbit) const
+{
+    return makeOrbitLayout(captureOrbit(orbit), randomSeed, orbit);
+}
+
+// what an orbit plays for its settings, from the parameters or from a program the audio thread switches to
+EventTimeline::OrbitLayout NewProjectAudioProcessor::makeOrbitLayout(const StateFormat::OrbitRecord& o, juce::uint32 seed, int orbit)
+{
+    auto rateIndex = juce::jlimit(0, juce::numElementsInArray(clockRateTicks) - 1, o.clockRate);
+
+    EventTimeline::OrbitLayout layout;
+    layout.steps = juce::jlimit(1, EuclideanPattern::maxSteps, o.stepCount);
+    layout.pattern = EuclideanPattern::get(layout.steps, o.pulseCount);
+    layout.reversed = o.reversed;
+    layout.stepTicks = clockRateTicks[rateIndex];
+    layout.note = noteNumber(o.outputNote, o.octave);
+    layout.channel = juce::jlimit(1, 16, o.channel);
+    layout.gate = (float)juce::jlimit(1, 100, o.gatePercent) * 0.01f;
+    layout.gateMs = o.gateInMs ? (float)juce::jmax(1, o.gateMs) : 0.0f;
+    layout.velocity = o.velocity;
+    layout.probability = o.probability;
+    layout.ratchet = o.ratchet;
+    layout.seed = StepLanes::orbitSeed(seed, orbit);
+    return layout;
+}
+
+void NewProjectAudioProcessor::markOrbitsDirty(juce::uint32 orbitMask)
+{
+    dirtyOrbits.fetch_or(orbitMask);
+    stateGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void NewProjectAudioProcessor::setStepVelocity(int orbit, int step, int velocity)
+{
+    if (juce::isPositiveAndBelow(orbit, numOrbits) && juce::isPositiveAndBelow(step, EuclideanPattern::maxSteps))
+    {
+        velocityLanes[orbit][step] = (juce::uint8)juce::jlimit(1, 127, velocity);
+        markOrbitsDirty(1u << orbit);
+    }
+}
+
+void NewProjectAudioProcessor::setStepProbability(int orbit, int step, int percent)
+{
+    if (juce::isPositiveAndBelow(orbit, numOrbits) && juce::isPositiveAndBelow(step, EuclideanPattern::maxSteps))
+    {
+        probabilityLanes[orbit][step] = (juce::uint8)juce::jlimit(0, (int)StepLanes::alwaysPlays, percent);
+        markOrbitsDirty(1u << orbit);
+    }
+}
+
+void NewProjectAudioProcessor::setStepRatchet(int orbit, int step, int repeats)
+{
+    if (juce::isPositiveAndBelow(orbit, numOrbits) && juce::isPositiveAndBelow(step, EuclideanPattern::maxSteps))
+    {
+        ratchetLanes[orbit][step] = (juce::uint8)juce::jlimit(1, (int)StepLanes::maxRatchets, repeats);
+        markOrbitsDirty(1u << orbit);
+    }
+}
+
+int NewProjectAudioProcessor::getStepVelocity(int orbit, int step) const
+{
+    return velocityLanes[(size_t)orbit][(size_t)step];
+}
+
+int NewProjectAudioProcessor::getStepProbability(int orbit, int step) const
+{
+    return probabilityLanes[(size_t)orbit][(size_t)step];
+}
+
+int NewProjectAudioProcessor::getStepRatchet(int orbit, int step) const
+{
+    return ratchetLanes[(size_t)orbit][(size_t)step];
+}
+
+void NewProjectAudioProcessor::setRandomSeed(juce::uint32 seed)
+{
+    randomSeed = seed;
+    markOrbitsDirty(allOrbits);
+}
+
+NewProjectAudioProcessor::GlobalSettings NewProjectAudioProcessor::parameterSettings() const
+{
+    GlobalSettings settings;
+    settings.speed = *speedParam;
+    settings.sync = *syncParam >= 0.5f;
+    settings.dot = *dotParam >= 0.5f;
+    settings.trip = *tripParam >= 0.5f;
+    settings.quantizeToBar = *quantizeParam >= 0.5f;
+    settings.midiThru = *thruParam >= 0.5f;
+    settings.followInput = *followParam >= 0.5f;
+    settings.retrigger = *retriggerParam >= 0.5f;
+    return settings;
+}
+
+// audio thread: a program that has taken over is played as it was saved until the parameters have caught up
+NewProjectAudioProcessor::GlobalSettings NewProjectAudioProcessor::currentSettings() const
+{
+    return activeProgram != nullptr ? activeProgram->settings : parameterSettings();
+}
+
+// one global step, in quarter notes, for Speed/Sync/Dot/Trip and the host tempo
+double NewProjectAudioProcessor::getStepQuarters(const GlobalSettings& settings) const
+{
+    auto speed = settings.speed;
+
+    // synced steps are a fraction of a bar, measured in quarter notes so the host's ppq can drive them
+    auto syncSpeed = 1 / std::pow(2.0f, (speed * 100.0f) - 90.0f); // the editor changes range from 90-100 with sync on. this function gives me denomenator of note value
+    auto stepQuarters = (! settings.sync) ?
+        0.25 * (0.1 + (1.0 - speed)) * bpm / 60.0 // free-running steps are a fixed time, whatever the tempo
+        : (4.0 * numerator / denominator) * syncSpeed;
+
+    if (settings.dot)
+        stepQuarters = stepQuarters * 1.5;
+    if (settings.trip)
+        stepQuarters = (stepQuarters * 2.0) / 3.0;
+
+    return juce::jmin(stepQuarters, maxStepQuarters);
+}
+
 const juce::String NewProjectAudioProcessor::getName() const
 {
     return JucePlugin_Name;
@@ -106,26 +425,225 @@ double NewProjectAudioProcessor::getTailLengthSeconds() const
 
 int NewProjectAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return juce::jmax(1, presets.size());   // NB: some hosts don't cope very well if you tell them there are 0 programs,
+                                            // so this should be at least 1, even if you're not really implementing programs.
 }
 
 int NewProjectAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram;
 }
 
+// switched on the audio thread at the next step like a program change coming in as MIDI, then copied into
+// the parameters by timerCallback(). with nothing playing there's no step to wait for
 void NewProjectAudioProcessor::setCurrentProgram(int index)
 {
+    if (! juce::isPositiveAndBelow(index, presets.size()))
+        return;
+
+    currentProgram = index;
+
+    if (! preparedToPlay.load())
+    {
+        loadProgram(index);
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    programRequests.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 > 0)
+        requestedPrograms[(size_t)start1] = index;
+
+    programRequests.finishedWrite(size1);
 }
 
 const juce::String NewProjectAudioProcessor::getProgramName(int index)
 {
-    return {};
+    return presets.getName(index);
 }
 
 void NewProjectAudioProcessor::changeProgramName(int index, const juce::String& newName)
 {
+    auto bank = readPresets();
+
+    if (juce::isPositiveAndBelow(index, (int)bank.size()))
+    {
+        bank[(size_t)index].name = newName;
+        writePresets(bank);
+    }
+}
+
+// message thread only
+void NewProjectAudioProcessor::loadProgram(int index)
+{
+    StateFormat::State state;
+
+    if (! presets.getState(index, state))
+        return;
+
+    currentProgram = index;
+    applyState(state);
+
+    // published now, even when no parameter changed, so the audio thread hands over from the program's own
+    // timeline to one that plays the same
+    rebuildTimeline(dirtyOrbits.exchange(0));
+}
+
+bool NewProjectAudioProcessor::saveCurrentAsPreset(const juce::String& name)
+{
+    auto bank = readPresets();
+
+    if ((int)bank.size() >= PresetBank::maxPresets)
+        return false;
+
+    bank.push_back({ name, captureState() });
+    return writePresets(bank);
+}
+
+std::vector<PresetBank::Preset> NewProjectAudioProcessor::readPresets() const
+{
+    std::vector<PresetBank::Preset> bank((size_t)presets.size());
+
+    for (int i = 0; i < presets.size(); i++)
+    {
+        bank[(size_t)i].name = presets.getName(i);
+        presets.getState(i, bank[(size_t)i].state);
+    }
+
+    return bank;
+}
+
+bool NewProjectAudioProcessor::writePresets(const std::vector<PresetBank::Preset>& bank)
+{
+    // the file can't be replaced while it's mapped
+    presets.close();
+
+    auto written = PresetBank::write(presetFile, bank);
+    presets.open(presetFile);
+    publishPrograms();
+    updateHostDisplay();
+    return written;
+}
+
+// message thread. a program's timeline can take a while to build, so every one is built here, well before it's played
+void NewProjectAudioProcessor::publishPrograms()
+{
+    auto& set = programs.beginWrite();
+    set.size = presets.size();
+
+    for (int i = 0; i < PresetBank::maxPresets; i++)
+    {
+        auto& program = set.programs[(size_t)i];
+        StateFormat::State state;
+
+        if (i >= set.size || ! presets.getState(i, state))
+        {
+            program.reset();
+            continue;
+        }
+
+        if (program == nullptr)
+            program = std::make_unique<ProgramSnapshot>();
+
+        buildProgram(state, i, *program);
+    }
+
+    programs.publish();
+}
+
+void NewProjectAudioProcessor::buildProgram(const StateFormat::State& state, int index, ProgramSnapshot& program)
+{
+    std::array<EventTimeline::OrbitLayout, numOrbits> layout;
+
+    for (int i = 0; i < numOrbits; i++)
+    {
+        auto o = state.orbits[i];
+        limitLanes(o);
+        layout[i] = makeOrbitLayout(o, state.seed, i);
+        program.rotation[(size_t)i] = o.rotation;
+    }
+
+    program.timeline.build(layout);
+    program.timeline.groove = state.groove.length > 0 ? state.groove : Groove::swing(state.swing);
+    program.settings.speed = juce::jlimit(0.01f, 1.0f, state.speed);
+    program.settings.sync = state.sync;
+    program.settings.dot = state.dot;
+    program.settings.trip = state.trip;
+    program.settings.quantizeToBar = state.quantizeToBar;
+    program.settings.midiThru = state.midiThru;
+    program.settings.followInput = state.followInput;
+    program.settings.retrigger = state.retrigger;
+    program.index = index;
+}
+
+// audio thread. a program that isn't in the bank is dropped
+void NewProjectAudioProcessor::queueProgram(int index)
+{
+    if (numQueued < (int)queuedPrograms.size())
+        queuedPrograms[(size_t)((firstQueued + numQueued++) % (int)queuedPrograms.size())] = index;
+
+    prepareNextProgram();
+}
+
+// audio thread. the oldest program queued waits for the next boundary
+void NewProjectAudioProcessor::prepareNextProgram()
+{
+    auto& set = programs.get();
+
+    while (pendingProgram == nullptr && numQueued > 0)
+    {
+        auto index = queuedPrograms[(size_t)firstQueued];
+        firstQueued = (firstQueued + 1) % (int)queuedPrograms.size();
+        numQueued--;
+
+        if (juce::isPositiveAndBelow(index, set.size))
+            pendingProgram = set.programs[(size_t)index].get();
+    }
+}
+
+const EventTimeline& NewProjectAudioProcessor::currentTimeline() const noexcept
+{
+    return activeProgram != nullptr ? activeProgram->timeline : timelines.get();
+}
+
+// audio thread. the timeline to switch to at the next boundary, a program waiting for one coming first.
+// published timelines built before the message thread caught up with the last program are out of date
+const EventTimeline* NewProjectAudioProcessor::fetchPendingTimeline()
+{
+    if (pendingProgram != nullptr)
+        return &pendingProgram->timeline;
+
+    auto* pending = timelines.fetch();
+
+    if (pending != nullptr && pending->programSequence < programSequence)
+    {
+        timelines.commit();
+        return nullptr;
+    }
+
+    return pending;
+}
+
+// audio thread. switches to what fetchPendingTimeline() returned
+const EventTimeline& NewProjectAudioProcessor::commitPendingTimeline()
+{
+    if (pendingProgram != nullptr)
+    {
+        activeProgram = pendingProgram;
+        pendingProgram = nullptr;
+        switchedProgram.store((juce::uint64)++programSequence << 32 | (juce::uint32)activeProgram->index);
+        programStarting = true;
+        prepareNextProgram();
+    }
+    else
+    {
+        timelines.commit();
+        activeProgram = nullptr;
+    }
+
+    grooveTableStale = true;
+    return currentTimeline();
 }
 
 //==============================================================================
@@ -133,17 +651,41 @@ void NewProjectAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBl
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    time = 0;                               // [4]
-    tempo = 112;
-    currentStep.assign(5, 0);
-    cycleChanged = true;
+    orbitOrigin.fill(0.0);                  // [4]
+    orbitOriginIndex.fill(-1);              // free-running orbits play their first step a whole step in
+    orbitStepSamples.fill(0.0);
+    nextStepIndex.fill(0);
+    timelineOrigin = 0.0;
+    timelineOriginTick = 0;
+    timelineSamplesPerTick = 0.0;
+    nextTimelineTick = 0;
+    wasPlaying = false;
+    currentStep.fill(0);
+    timelines.acquire();
+
+    if (activeProgram == nullptr && pendingProgram == nullptr)
+        programs.acquire();
+
+    preparedToPlay = true;
     rate = static_cast<float> (sampleRate); // [5]
+    statistics.reset();
+
+    // room for the most a block can send, so the callback never grows it; once the host buffer has been swapped
+    // in a few times both sides keep their capacity. only input passed straight through can add to that
+    outputMidi.ensureSize(outputMidiBytes);
+    scheduledNotes.reset();
+    delayedThru.reset();
+    samplesPlayed = 0;
+    grooveTableStale = true;
+    updateLatency();
+    heldNotes.fill(0);
 }
 
 void NewProjectAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    preparedToPlay = false;
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -172,18 +714,10 @@ bool NewProjectAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts
 }
 #endif
 
-juce::String vecToString(std::vector<bool> vec)
-{
-    juce::String s = "";
-    for (auto v : vec)
-    {
-        s += (juce::String)((v)? "|true" : "|false");
-    }
-    return s;
-}
-
 void NewProjectAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi)
 {
+    // with EUCLID_REALTIME_AUDIT on, any allocation from here until we return is reported
+    RealtimeAudit::ScopedRealtimeSection realtimeSection;
 
     // the audio buffer in a midi effect will have zero channels!
     // but we need an audio buffer to getNumSamples....so....this next line will stay commented
@@ -192,163 +726,603 @@ void NewProjectAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, ju
     // however we use the buffer to get timing information
     auto numSamples = buffer.getNumSamples();                                                       // [7]
 
-    juce::MidiBuffer processedMidi;
+#if EUCLID_INSTRUMENTATION
+    auto startTicks = juce::Time::getHighResolutionTicks();
+#endif
+
+    auto& processedMidi = outputMidi;
+    processedMidi.clear();
+    notesLeftInBlock = maxNotesPerBlock;
 
     //bool done = false;
 
-    if (getPlayHead() != nullptr)
-        getPlayHead()->getCurrentPosition(playHeadInfo);
-    tempo = playHeadInfo.bpm;
-    numerator = playHeadInfo.timeSigNumerator;
-
-    auto speed = treeState.getRawParameterValue("Speed");
-    auto sync = treeState.getRawParameterValue("Sync");
-    auto dot = treeState.getRawParameterValue("Dot");
-    auto trip = treeState.getRawParameterValue("Trip");
-
-    // get note duration
-    syncSpeed = 1 / std::pow(2.0f, (*speed * 100.0f) - 90.0f); // the editor changes range from 90-100 with sync on. this function gives me denomenator of note value
-    auto noteDuration = (!*sync) ?
-        static_cast<int> (std::ceil(rate * 0.25f * (0.1f + (1.0f - (*speed)))))
-        : static_cast<int> (std::ceil(rate * 0.25f * (tempo / 60) * numerator * syncSpeed)); // should correspond to one quarter note w/o syncSpeed
-   
-    if (*dot)
-        noteDuration = noteDuration * 1.5f;
-    if (*trip)
-        noteDuration = (noteDuration * 2.0f) / 3.0f;
-
-    //noteDuration *= 10;
-
-    if (ntDrtn != noteDuration)
-        ntDrtn = noteDuration;
-
-    done = true;
-    //I only want to do this loop if a value has changed....
-    if (cycleChanged)
-    {
-        //done = false;
-        cycleChanged = false;
-        orbits.clear();
-        orbits.assign(5, { false });
-        
-        for (int i = 0; i < 5; i++)
+    auto hasPosition = getPlayHead() != nullptr && getPlayHead()->getCurrentPosition(playHeadInfo);
+    bpm = (hasPosition && playHeadInfo.bpm > 0.0) ? playHeadInfo.bpm : 120.0;
+    numerator = (hasPosition && playHeadInfo.timeSigNumerator > 0) ? playHeadInfo.timeSigNumerator : 4;
+    denominator = (hasPosition && playHeadInfo.timeSigDenominator > 0) ? playHeadInfo.timeSigDenominator : 4;
+    auto samplesPerQuarter = rate * 60.0 / bpm;
+
+    // a newer bank is only taken while no program from this one is playing or waiting, as the message thread
+    // rebuilds the old one in place. programs the host asked for queue up behind any that came in as MIDI
+    if (activeProgram == nullptr && pendingProgram == nullptr)
+        programs.acquire();
+
+    int start1, size1, start2, size2;
+    programRequests.prepareToRead(programRequests.getNumReady(), start1, size1, start2, size2);
+
+    for (int i = 0; i < size1; i++)
+        queueProgram(requestedPrograms[(size_t)(start1 + i)]);
+
+    for (int i = 0; i < size2; i++)
+        queueProgram(requestedPrograms[(size_t)(start2 + i)]);
+
+    programRequests.finishedRead(size1 + size2);
+
+    // with sync on, orbit positions are derived from the host's ppq every block, so tempo changes,
+    // loops and relocations stay on the grid and nothing runs while the transport is stopped
+    BlockTiming timing;
+    timing.blockStart = samplesPlayed;
+    timing.startSample = 0;
+    timing.endSample = numSamples;
+    timing.samplesPerQuarter = samplesPerQuarter;
+    timing.barQuarters = 4.0 * numerator / denominator;
+    timing.ppq = playHeadInfo.ppqPosition;
+    timing.hasPosition = hasPosition;
+    applySettings(timing);
+
+    // every orbit parameter the audio thread plays from lives in one published snapshot, never read
+    // piecemeal here. a newer one is switched to at the next step (or bar) boundary, except when the
+    // host is stopped or the orbits are clocked one by one, which both take it straight away. a program
+    // taken straight away brings its settings with it before anything is timed from them
+    if (auto* pending = fetchPendingTimeline())
+        if (! pending->isValid() || ! currentTimeline().isValid() || (timing.transportLocked && ! timing.playing))
         {
+            commitPendingTimeline();
+            applySettings(timing);
+        }
+
+    // hosts that run a little ahead of where the last block ended are only drifting, the steps carry on from
+    // the first one not fired yet. the transport has been moved if it went back, or forward past a whole tick
+    auto drift = (timing.ppq - expectedPpq) * samplesPerQuarter;
+    auto jumped = timing.playing && wasPlaying && (drift < -0.5 || drift > timing.stepSamples / EventTimeline::ticksPerStep);
+    timing.continuing = timing.playing && wasPlaying && ! jumped;
+
+    if (wasPlaying && ! timing.continuing)
+        scheduledNotes.releaseAll(processedMidi, 0);
+
+    wasPlaying = timing.playing;
+    expectedPpq = timing.ppq + numSamples / samplesPerQuarter;
+
+    updateGrooveTable(timing.stepSamples);
+
+    // incoming events are handled at their own sample: the block is rendered in pieces split at each of them,
+    // so a held note or a retrigger affects exactly the steps from that sample on. everything is added in
+    // time order, which keeps the merge with the generated notes a plain append into reserved space
+    auto stepsFired = 0;
+
+    for (const auto metadata : midi)
+    {
+        auto position = juce::jlimit(0, juce::jmax(0, numSamples - 1), metadata.samplePosition);
 
-            steps = (int)(*treeState.getRawParameterValue("StepCount" + std::to_string(i + 1)));
-            pulses = (int)(*treeState.getRawParameterValue("PulseCount" + std::to_string(i + 1)));
-         
-            orbits[i].assign(steps, false);
-            auto check = std::string(orbits[i].begin(), orbits[i].end());
+        stepsFired += renderUntil(processedMidi, timing, position);
+        timing.continuing = timing.playing;
 
+        handleInputEvent(metadata, timing);
 
-            if (pulses >= steps)
+        // passed through as late as the notes are played, so the two stay together. only sysex, too long to
+        // hold back, goes straight out
+        if (timing.settings.midiThru)
+        {
+            if (metadata.numBytes <= 3)
             {
-                orbits[i].assign(steps, true);
+                delayedThru.push(processedMidi, position, samplesPlayed + position + grooveLookahead, metadata.data, metadata.numBytes);
+                delayedThru.dispatchUntil(processedMidi, samplesPlayed, samplesPlayed + position + 1);
             }
-
-            if (pulses > 0 && pulses < steps)
+            else
             {
-                //evenly distributes steps of the orbit
-                for (int x = 0; x < pulses; x++)
-                {
-                    cycleSteps.push_back((int)(steps / pulses));
-                }
-
-
-                //evenly spaces the remainder across the orbit 
-                auto m = steps % pulses;
-                if (m)
-                {
-                    auto skip = (int)(juce::roundToIntAccurate(pulses / m));
-
-                    for (int x = 0; x < pulses; x += (int)(juce::roundToIntAccurate(pulses / m)))
-                    {
-                        cycleSteps[x] = cycleSteps[x] + 1;
-
-                        if (m - (x + 1) == 0) // break loop when we've added 'remainder' number of steps between pulses
-                        {
-                            x = pulses;
-                        }
-                    }
-                }
-
-                auto checkCycleSteps = std::string(cycleSteps.begin(), cycleSteps.end());
-
-
-                // adds pulse pattern to the vector of orbits
-                auto pulseLocation = (uint8)0;
-                for (auto x : cycleSteps)
-                {
-                    pulseLocation += x;
-                    orbits[i][pulseLocation % steps] = true;
-                }
-
-                for (auto o : orbits)
-                {
-                    auto checkOrbits = vecToString(o);
-                }
+                processedMidi.addEvent(metadata.data, metadata.numBytes, position);
             }
+        }
+    }
+
+    stepsFired += renderUntil(processedMidi, timing, numSamples);
 
+    if (stepsFired > 0)
+        displayChannel.write(displayState);
+
+    samplesPlayed += numSamples;
+
+    //always use swapWith(), avoids unpredictable behavior from directly editing midi buffer
+    midi.swapWith(processedMidi);
+
+#if EUCLID_INSTRUMENTATION
+    statistics.addBlock(juce::Time::getHighResolutionTicks() - startTicks, numSamples, midi.getNumEvents(), stepsFired);
+#endif
+}
 
-            cycleSteps.clear();
+// the step length and everything else the global settings decide, for the block or, once a program has
+// taken over part way through it, for the rest of it
+void NewProjectAudioProcessor::applySettings(BlockTiming& timing)
+{
+    timing.settings = currentSettings();
+
+    // kept fractional: rounding the step length up to whole samples made long sequences drift off the grid
+    auto stepQuarters = getStepQuarters(timing.settings);
+    timing.stepSamples = juce::jmax(1.0, stepQuarters * timing.samplesPerQuarter);
+    timing.stepQuarters = juce::jmax(1.0 / timing.samplesPerQuarter, stepQuarters);
+    timing.transportLocked = timing.settings.sync && timing.hasPosition;
+    timing.playing = timing.transportLocked && playHeadInfo.isPlaying;
+    followInput = timing.settings.followInput;
+}
+
+// renders the block up to 'endSample'. a program taking over on the way stops the segment at its boundary,
+// and what's left is timed again from there with the program's step length, sync and the rest
+int NewProjectAudioProcessor::renderUntil(juce::MidiBuffer& processedMidi, BlockTiming& timing, int endSample)
+{
+    auto stepsFired = 0;
+
+    for (;;)
+    {
+        timing.endSample = endSample;
+        stepsFired += renderSegment(processedMidi, timing);
+
+        if (switchedAt < 0)
+            break;
+
+        auto previous = timing;
+        timing.startSample = switchedAt;
+        switchedAt = -1;
+        applySettings(timing);
+        updateGrooveTable(timing.stepSamples);
+
+        // free-running, the program's first step is the boundary it took over at
+        if (! timing.transportLocked)
+        {
+            timelineOrigin = (double)(timing.blockStart + timing.startSample);
+            timelineOriginTick = nextTimelineTick;
+            timelineSamplesPerTick = timing.stepSamples / EventTimeline::ticksPerStep;
         }
-        //done = true;
+
+        // turning sync off lets go of what the transport was playing, as it does between blocks
+        if (previous.playing && ! timing.playing)
+            scheduledNotes.releaseAll(processedMidi, timing.startSample);
+
+        timing.continuing = previous.playing && timing.playing && timing.stepQuarters == previous.stepQuarters;
+        wasPlaying = timing.playing;
     }
-    
 
+    timing.startSample = endSample;
+    return stepsFired;
+}
 
-    // .........................................................................................................................
+// the precomputed cycle covers almost every configuration, orbits are only clocked one by one
+// when their combined cycle is too long to flatten
+int NewProjectAudioProcessor::renderSegment(juce::MidiBuffer& processedMidi, const BlockTiming& timing)
+{
+    auto& timeline = currentTimeline();
+
+    auto stepsFired = timeline.isValid() ? renderTimeline(processedMidi, timing)
+                                         : renderOrbitClocks(timeline, processedMidi, timing);
+
+    // notes end, and ratchets repeat, between steps and blocks after the step that started them
+    auto endSample = switchedAt >= 0 ? switchedAt : timing.endSample;
+    scheduledNotes.dispatchUntil(processedMidi, timing.blockStart, timing.blockStart + endSample);
+    delayedThru.dispatchUntil(processedMidi, timing.blockStart, timing.blockStart + endSample);
+    return stepsFired;
+}
+
+int NewProjectAudioProcessor::renderTimeline(juce::MidiBuffer& processedMidi, const BlockTiming& timing)
+{
+    auto* timeline = &currentTimeline();
+    auto samplesPerTick = timing.stepSamples / EventTimeline::ticksPerStep;
+    auto segmentStart = (double)(timing.blockStart + timing.startSample);
+    auto segmentLength = (double)(timing.endSample - timing.startSample);
+
+    // every tick is placed from one origin, tick 'originTick' being 'originSample' samples from the start of
+    // the segment, rather than stepped on from the last one. the same tick then lands on the same sample
+    // however the host splits the blocks
+    double originTick, originSample;
+
+    if (timing.playing)
+    {
+        originTick = timing.ppq / timing.stepQuarters * EventTimeline::ticksPerStep;
+        originSample = -timing.startSample;
+    }
+    else if (timing.transportLocked)
+    {
+        return 0;
+    }
+    else
+    {
+        retimeClock(timelineOrigin, timelineOriginTick, timelineSamplesPerTick, samplesPerTick, segmentStart);
+        originTick = (double)timelineOriginTick;
+        originSample = timelineOrigin - segmentStart;
+    }
+
+    auto sampleAt = [&](juce::int64 t)
+    {
+        return std::floor(originSample + ((double)t - originTick) * samplesPerTick + sampleTolerance);
+    };
+
+    auto tick = (juce::int64)std::ceil(originTick - originSample / samplesPerTick);
 
+    if (sampleAt(tick - 1) >= 0.0)
+        tick--;
 
-    if ((time + numSamples) >= noteDuration && done)                                                      
-    {  
-        auto offset = juce::jmax(0, juce::jmin((int)(noteDuration - time), numSamples - 1));
+    // hosts don't always report exactly where the last block ended: carry on from the first tick not fired yet,
+    // so none is fired twice or skipped. anything further back was left by the per-orbit clocks
+    if (timing.continuing && nextTimelineTick >= tick - 1)
+        tick = nextTimelineTick;
 
-        for(auto note : notes)
-            processedMidi.addEvent(juce::MidiMessage::noteOff(1, note), offset);
-        notes.clear();
+    nextTimelineTick = tick;
+
+    juce::int64 cycle = 0, cycleIndex = 0;
+    int index = 0;
+
+    auto seek = [&](juce::int64 fromTick)
+    {
+        cycle = (juce::int64)timeline->getCycleTicks();
+        cycleIndex = floorDivide(fromTick, cycle);
+        index = timeline->indexAtOrAfter((juce::uint64)(fromTick - cycleIndex * cycle));
+    };
 
-        // every cycle moves a step 
-        for (int i = 0; i < 5; i++)
+    seek(tick);
+
+    // a newer snapshot waiting to be played takes over at the first boundary from here. one that can't be
+    // flattened waits for processBlock to hand the next block to the per-orbit clocks. a program that has
+    // just taken over plays its first step before anything else can, so none is skipped
+    auto* pending = fetchPendingTimeline();
+
+    if (pending != nullptr && ! pending->isValid())
+        pending = nullptr;
+
+    auto switchingProgram = pending != nullptr && pendingProgram != nullptr;
+    auto switchTick = pending != nullptr && ! programStarting ? nextBoundaryTick(tick, timing)
+                                                              : std::numeric_limits<juce::int64>::max();
+    auto stepsFired = 0;
+
+    for (;;)
+    {
+        if (index == timeline->size())
         {
-            steps = (int)(*treeState.getRawParameterValue("StepCount" + std::to_string(i + 1)));
+            index = 0;
+            cycleIndex++;
+        }
 
-            currentStep[i] = ((int)(*treeState.getRawParameterValue("Reversed" + std::to_string(i + 1))) == false) ?
-                (currentStep[i]+1) % steps 
-                : steps - ( (steps-currentStep[i]) % steps ) - 1;
+        auto& e = (*timeline)[index];
+        auto absoluteTick = cycleIndex * cycle + (juce::int64)e.tick;
 
-            //add note for each orbit with currentStep that returns 'true'   
-            for (auto o : orbits)
+        if (pending != nullptr && absoluteTick >= switchTick && sampleAt(switchTick) < segmentLength)
+        {
+            timeline = &commitPendingTimeline();
+            pending = nullptr;
+
+            // a program's step length and settings may differ, renderUntil() times the rest of the block again
+            if (switchingProgram)
             {
-                auto checkOrbits = std::string(o.begin(), o.end());
+                switchedAt = timing.startSample + (int)juce::jmax(0.0, sampleAt(switchTick));
+                nextTimelineTick = switchTick;
+                break;
             }
 
+            updateGrooveTable(timing.stepSamples);
+            seek(switchTick);
+            continue;
+        }
 
-            if ( orbits[i][currentStep[i]] )
-            {
-                treeState.getParameter("PulseActive" + std::to_string(i + 1))->setValueNotifyingHost(1.0f);
-                
-               
-                auto note = noteToInt(treeState.getParameter("OutputNote" + std::to_string(i + 1))->getCurrentValueAsText());
-                note = note + ( 12 * (int)(*treeState.getRawParameterValue("iOctave" + std::to_string(i + 1))) );
-                processedMidi.addEvent(juce::MidiMessage::noteOn(1, note, (juce::uint8)84), offset);
-                notes.add(note);
-            }
-            else
-            {
-                treeState.getParameter("PulseActive" + std::to_string(i + 1))->setValueNotifyingHost(0.0f);
-            } 
+        auto position = sampleAt(absoluteTick);
+
+        // the next block carries on from this event, however little of the way to it the host drifts ahead
+        if (position >= segmentLength)
+        {
+            nextTimelineTick = absoluteTick;
+            break;
+        }
+
+        auto offset = timing.startSample + (int)juce::jmax(0.0, position);
+
+        if (programStarting)
+        {
+            programStarting = false;
 
+            if (pending != nullptr)
+                switchTick = nextBoundaryTick(absoluteTick + 1, timing);
         }
 
-        treeState.getParameter("ForceStep")->setValueNotifyingHost(!treeState.getRawParameterValue("ForceStep"));// should ping OrbitComponent to repaint
+        scheduledNotes.dispatchUntil(processedMidi, timing.blockStart, timing.blockStart + offset + 1);
+        delayedThru.dispatchUntil(processedMidi, timing.blockStart, timing.blockStart + offset + 1);
+
+        // only the orbits stepping here are visited, lowest first
+        for (auto bits = e.stepping; bits != 0; bits &= bits - 1)
+        {
+            auto i = countTrailingZeros(bits);
+            auto& layout = timeline->layout[i];
+            advanceOrbit(i, processedMidi, offset, layout, layout.stepTicks * samplesPerTick,
+                         timeline->stepAt(i, e.tick), absoluteTick);
+            stepsFired++;
+        }
+
+        index++;
     }
 
-    time = (time + numSamples) % noteDuration;                                                      
+    return stepsFired;
+}
 
-    //always use swapWith(), avoids unpredictable behavior from directly editing midi buffer
-   
-    midi.swapWith(processedMidi);
+int NewProjectAudioProcessor::renderOrbitClocks(const EventTimeline& timeline, juce::MidiBuffer& processedMidi, const BlockTiming& timing)
+{
+    auto& layout = timeline.layout;
+
+    // every orbit runs its own clock, one step being the global step length scaled by its rate.
+    // fire every step boundary of every orbit in timestamp order. like the timeline's ticks, each boundary
+    // is placed from a fixed origin: the host's ppq, or for free-running orbits the sample their clock
+    // was last started or retimed at, so fractional step lengths never drift
+    auto numSamples = (double)(timing.endSample - timing.startSample);
+    auto segmentStart = (double)(timing.blockStart + timing.startSample);
+    std::array<double, numOrbits> stepLength, orbitQuarters, samplesToNextStep;
+
+    // where an orbit's index'th step falls, in whole samples from the start of the segment
+    auto samplesTo = [&](int i, juce::int64 index)
+    {
+        auto exact = timing.playing ? ((double)index * orbitQuarters[i] - timing.ppq) * timing.samplesPerQuarter - timing.startSample
+                                    : orbitOrigin[i] + (double)(index - orbitOriginIndex[i]) * stepLength[i] - segmentStart;
+        return std::floor(exact + sampleTolerance);
+    };
+
+    for (int i = 0; i < numOrbits; i++)
+    {
+        auto stepScale = (double)layout[i].stepTicks / EventTimeline::ticksPerStep;
+        stepLength[i] = timing.stepSamples * stepScale;
+        orbitQuarters[i] = timing.stepQuarters * stepScale;
+
+        if (timing.playing)
+        {
+            auto first = (juce::int64)std::ceil((timing.ppq + timing.startSample / timing.samplesPerQuarter) / orbitQuarters[i]);
+
+            if (samplesTo(i, first - 1) >= 0.0)
+                first--;
+
+            // hosts don't always report exactly where the last block ended, never fire a boundary twice or skip one
+            if (timing.continuing && nextStepIndex[i] >= first - 1)
+                first = nextStepIndex[i];
+
+            nextStepIndex[i] = first;
+        }
+        else if (timing.transportLocked)
+        {
+            samplesToNextStep[i] = std::numeric_limits<double>::max();
+            continue;
+        }
+        else
+        {
+            retimeClock(orbitOrigin[i], orbitOriginIndex[i], orbitStepSamples[i], stepLength[i], segmentStart);
+
+            auto first = (juce::int64)std::ceil((double)orbitOriginIndex[i] + (segmentStart - orbitOrigin[i]) / stepLength[i]);
+
+            if (samplesTo(i, first - 1) >= 0.0)
+                first--;
+
+            // the clock wasn't running if the timeline or the host had the orbits, pick up from
+            // where it is now rather than firing every step missed since in one go
+            if (nextStepIndex[i] < first - 1 || nextStepIndex[i] > first)
+                nextStepIndex[i] = first;
+        }
+
+        samplesToNextStep[i] = juce::jmax(0.0, samplesTo(i, nextStepIndex[i]));
+    }
+
+    auto stepsFired = 0;
+
+    for (;;)
+    {
+        auto next = *std::min_element(samplesToNextStep.begin(), samplesToNextStep.end());
+
+        if (next >= numSamples)
+            break;
+
+        auto offset = timing.startSample + (int)next;
+        juce::uint32 firing = 0;
+
+        for (int i = 0; i < numOrbits; i++)
+            firing |= (juce::uint32)(samplesToNextStep[i] <= next) << i;
+
+        scheduledNotes.dispatchUntil(processedMidi, timing.blockStart, timing.blockStart + offset + 1);
+        delayedThru.dispatchUntil(processedMidi, timing.blockStart, timing.blockStart + offset + 1);
+
+        for (auto bits = firing; bits != 0; bits &= bits - 1)
+        {
+            auto i = countTrailingZeros(bits);
+            auto step = timing.transportLocked ? EventTimeline::stepAtIndex(layout[i], nextStepIndex[i])
+                                               : followingStep(i, layout[i]);
+            advanceOrbit(i, processedMidi, offset, layout[i], stepLength[i], step, nextStepIndex[i] * layout[i].stepTicks);
+            nextStepIndex[i]++;
+            samplesToNextStep[i] = juce::jmax(next, samplesTo(i, nextStepIndex[i]));
+            stepsFired++;
+        }
+    }
+
+    return stepsFired;
+}
+
+// moves a free-running clock onto a new step length, keeping the fraction of the current step already played
+void NewProjectAudioProcessor::retimeClock(double& origin, juce::int64& originIndex, double& stepSamples, double newStepSamples, double now)
+{
+    if (newStepSamples == stepSamples)
+        return;
+
+    if (stepSamples > 0.0)
+    {
+        auto next = (juce::int64)std::ceil((double)originIndex + (now - origin) / stepSamples);
+        auto nextSample = origin + (double)(next - originIndex) * stepSamples;
+        origin = now + (nextSample - now) * newStepSamples / stepSamples;
+        originIndex = next;
+    }
+
+    stepSamples = newStepSamples;
+}
+
+int NewProjectAudioProcessor::followingStep(int orbit, const EventTimeline::OrbitLayout& layout) const
+{
+    auto steps = layout.steps;
+
+    return (layout.reversed == false) ?
+        (currentStep[orbit]+1) % steps 
+        : steps - ( (steps-currentStep[orbit]) % steps ) - 1;
+}
+
+// keeps track of the notes held on the input and acts on anything else the sequencer listens to
+void NewProjectAudioProcessor::handleInputEvent(const juce::MidiMessageMetadata& event, const BlockTiming& timing)
+{
+    auto* data = event.data;
+    auto status = event.numBytes > 0 ? data[0] & 0xf0 : 0;
+
+    // program changes are played from the next step boundary, see fetchPendingTimeline()
+    if (event.numBytes == 2 && status == 0xc0)
+    {
+        queueProgram(data[1]);
+    }
+    else if (event.numBytes == 3 && (status == 0x90 || status == 0x80))
+    {
+        auto note = data[1] & 0x7f;
+        auto bit = 1u << (note & 31);
+
+        if (status == 0x90 && data[2] > 0)
+        {
+            heldNotes[(size_t)(note >> 5)] |= bit;
+
+            // the transport decides where synced orbits are, only free-running ones can be restarted
+            if (timing.settings.retrigger && ! timing.transportLocked)
+                restartOrbits((double)(timing.blockStart + timing.startSample));
+        }
+        else
+        {
+            heldNotes[(size_t)(note >> 5)] &= ~bit;
+        }
+    }
+    else if (event.numBytes == 3 && status == 0xb0 && (data[1] == 120 || data[1] == 123))
+    {
+        heldNotes.fill(0);  // all sound off, all notes off
+    }
+}
+
+// every orbit plays its first step at sample 'now'
+void NewProjectAudioProcessor::restartOrbits(double now)
+{
+    timelineOrigin = now;
+    timelineOriginTick = 0;
+    orbitOrigin.fill(now);
+    orbitOriginIndex.fill(0);
+    nextStepIndex.fill(0);
+
+    // the orbit clocks move on from currentStep, leave it one step before the start
+    for (int i = 0; i < numOrbits; i++)
+    {
+        auto& layout = currentTimeline().layout[i];
+        currentStep[i] = layout.reversed ? 1 % layout.steps : layout.steps - 1;
+    }
+}
+
+// with FollowInput on, orbits take the held notes lowest first, wrapping round when there are more
+// orbits than notes. -1 when nothing is held
+int NewProjectAudioProcessor::heldNoteFor(int orbit) const
+{
+    auto count = 0;
+
+    for (auto word : heldNotes)
+        count += juce::countNumberOfBits(word);
+
+    if (count == 0)
+        return -1;
+
+    auto remaining = orbit % count;
+
+    for (int w = 0; w < (int)heldNotes.size(); w++)
+    {
+        auto bits = (int)juce::countNumberOfBits(heldNotes[(size_t)w]);
+
+        if (remaining >= bits)
+        {
+            remaining -= bits;
+            continue;
+        }
+
+        for (int b = 0; b < 32; b++)
+            if ((heldNotes[(size_t)w] & (1u << b)) != 0 && remaining-- == 0)
+                return w * 32 + b;
+    }
+
+    return -1;
+}
+
+void NewProjectAudioProcessor::updateGrooveTable(double stepSamples)
+{
+    auto lookahead = lookaheadSamples.load(std::memory_order_relaxed);
+
+    if (! grooveTableStale && stepSamples == grooveStepSamples && lookahead == grooveLookahead)
+        return;
+
+    // steps can only be pulled as early as the lookahead allows
+    grooveTable = Groove::scale(currentTimeline().groove, stepSamples, lookahead);
+    grooveTableStale = false;
+    grooveStepSamples = stepSamples;
+    grooveLookahead = lookahead;
+}
+
+// the first tick at or after 'tick' where a new pattern may take over
+juce::int64 NewProjectAudioProcessor::nextBoundaryTick(juce::int64 tick, const BlockTiming& timing)
+{
+    if (! timing.settings.quantizeToBar)
+        return floorDivide(tick + EventTimeline::ticksPerStep - 1, EventTimeline::ticksPerStep) * EventTimeline::ticksPerStep;
+
+    // bars needn't be a whole number of ticks (dotted or triplet steps), round up to the first tick after the bar line.
+    // that tick is itself the boundary of the bar line just before it, or it would move on a bar when asked again
+    auto barTicks = timing.barQuarters / timing.stepQuarters * EventTimeline::ticksPerStep;
+    auto bar = std::floor(((double)tick - 1.0 + 1.0e-6) / barTicks) + 1.0;
+    return juce::jmax(tick, (juce::int64)std::ceil(bar * barTicks - 1.0e-6));
+}
+
+juce::int64 NewProjectAudioProcessor::floorDivide(juce::int64 a, juce::int64 b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+void NewProjectAudioProcessor::advanceOrbit(int orbit, juce::MidiBuffer& processedMidi, int offset, const EventTimeline::OrbitLayout& layout,
+                                            double stepSamples, int step, juce::int64 tick)
+{
+    currentStep[orbit] = step;
+    displayState.currentStep[orbit] = currentStep[orbit];
+
+    // following the input, an orbit rests while nothing is held
+    auto note = followInput ? heldNoteFor(orbit) : layout.note;
+    auto rotation = activeProgram != nullptr ? activeProgram->rotation[(size_t)orbit] : (int)(*orbitParams[orbit].rotation);
+    auto notes = EventTimeline::notesAt(layout, rotation, step, (juce::uint64)tick, stepSamples, 0.001 * rate);
+
+    // once the block has started as many notes as its output has room for, the rest of its steps rest
+    auto repeats = juce::jmin(notes.repeats, notesLeftInBlock);
+
+    if (repeats > 0 && note >= 0)
+    {
+        displayState.pulseActive |= (1u << orbit);
+        notesLeftInBlock -= repeats;
+
+        // everything is played the lookahead late, so the groove can move a step either way of it. the repeats
+        // are booked with the scheduler, as a long step's can land blocks later
+        auto delay = juce::roundToInt(grooveLookahead + Groove::offsetAt(grooveTable, tick, EventTimeline::ticksPerStep));
+        auto start = samplesPlayed + offset + juce::jmax(0, delay);
+        auto gateSamples = (juce::int64)notes.gateLength;
+
+        if (delay <= 0)
+            scheduledNotes.play(processedMidi, samplesPlayed, offset, layout.channel, note, notes.velocity, gateSamples);
+        else
+            scheduledNotes.playLater(processedMidi, offset, start, layout.channel, note, notes.velocity, gateSamples);
+
+        for (int r = 1; r < repeats; r++)
+            scheduledNotes.playLater(processedMidi, offset, start + (juce::int64)(r * notes.repeatLength),
+                                     layout.channel, note, notes.velocity, gateSamples);
+    }
+    else
+    {
+        displayState.pulseActive &= ~(1u << orbit);
+    } 
 }
 
 //==============================================================================
@@ -369,10 +1343,23 @@ void NewProjectAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
 
-    auto state = treeState.copyState();
-    std::unique_ptr<juce::XmlElement> xml(state.createXml());
-    copyXmlToBinary(*xml, destData);
-   
+    // packed binary records rather than XML, hosts autosave often (see StateFormat.h).
+    // most autosaves find nothing changed since the last one and get the same blob back
+    const juce::ScopedLock sl(stateLock);
+    auto generation = stateGeneration.load(std::memory_order_acquire);
+    auto cacheHit = cachedStateGeneration == generation && ! cachedState.isEmpty();
+
+    if (! cacheHit)
+    {
+        StateFormat::write(captureState(), cachedState);
+        cachedStateGeneration = generation;
+    }
+
+    destData = cachedState;
+
+#if EUCLID_INSTRUMENTATION
+    statistics.addStateRequest(cacheHit);
+#endif
 }
 
 void NewProjectAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
@@ -380,13 +1367,151 @@ void NewProjectAudioProcessor::setStateInformation(const void* data, int sizeInB
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
 
-    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
+    if (StateFormat::isBinaryState(data, sizeInBytes))
+    {
+        StateFormat::State state;
+
+        if (StateFormat::read(data, sizeInBytes, state))
+            applyState(state);
+    }
+    else
+    {
+        // sessions saved before the binary format stored the parameter tree as XML. they had no lanes, seed or
+        // groove of their own, so those go back to their defaults rather than keeping whatever was loaded last
+        std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
+
+        if (xmlState.get() != nullptr)
+            if (xmlState->hasTagName(treeState.state.getType()))
+            {
+                applyState(StateFormat::State {});
+                treeState.replaceState(juce::ValueTree::fromXml(*xmlState));
+            }
+    }
+}
+
+StateFormat::State NewProjectAudioProcessor::captureState() const
+{
+    StateFormat::State state;
+    state.speed = *speedParam;
+    state.sync = *syncParam >= 0.5f;
+    state.dot = *dotParam >= 0.5f;
+    state.trip = *tripParam >= 0.5f;
+    state.quantizeToBar = *quantizeParam >= 0.5f;
+    state.midiThru = *thruParam >= 0.5f;
+    state.followInput = *followParam >= 0.5f;
+    state.retrigger = *retriggerParam >= 0.5f;
+    state.swing = *swingParam;
+    state.lookaheadMs = *lookaheadParam;
+    state.groove = customGroove;
+    state.seed = randomSeed;
+
+    for (int i = 0; i < numOrbits; i++)
+        state.orbits[i] = captureOrbit(i);
+
+    return state;
+}
+
+StateFormat::OrbitRecord NewProjectAudioProcessor::captureOrbit(int orbit) const
+{
+    auto& p = orbitParams[orbit];
+    StateFormat::OrbitRecord o;
+
+    o.on = *p.onButton >= 0.5f;
+    o.reversed = *p.reversed >= 0.5f;
+    o.stepCount = (int)(*p.stepCount);
+    o.pulseCount = (int)(*p.pulseCount);
+    o.outputNote = (int)(*p.outputNote);
+    o.octave = (int)(*p.octave);
+    o.clockRate = (int)(*p.clockRate);
+    o.rotation = (int)(*p.rotation);
+    o.channel = (int)(*p.channel);
+    o.gateInMs = *p.gateMode >= 0.5f;
+    o.gatePercent = (int)(*p.gateLength);
+    o.gateMs = (int)(*p.gateTime);
+    o.velocity = velocityLanes[orbit];
+    o.probability = probabilityLanes[orbit];
+    o.ratchet = ratchetLanes[orbit];
+    return o;
+}
+
+void NewProjectAudioProcessor::applyState(const StateFormat::State& state)
+{
+    auto set = [this](const juce::String& id, float value)
+    {
+        if (auto* p = treeState.getParameter(id))
+            p->setValueNotifyingHost(p->convertTo0to1(value));
+    };
+
+    set("Speed", state.speed);
+    set("Sync", state.sync ? 1.0f : 0.0f);
+    set("Dot", state.dot ? 1.0f : 0.0f);
+    set("Trip", state.trip ? 1.0f : 0.0f);
+    set("Quantize", state.quantizeToBar ? 1.0f : 0.0f);
+    set("MidiThru", state.midiThru ? 1.0f : 0.0f);
+    set("FollowInput", state.followInput ? 1.0f : 0.0f);
+    set("Retrigger", state.retrigger ? 1.0f : 0.0f);
+    set("Swing", state.swing);
+    set("Lookahead", state.lookaheadMs);
+    setGrooveTemplate(state.groove);
+
+    for (int i = 0; i < numOrbits; i++)
+    {
+        auto id = juce::String(i + 1);
+        auto o = state.orbits[i];
+
+        set("bOnButton" + id, o.on ? 1.0f : 0.0f);
+        set("Reversed" + id, o.reversed ? 1.0f : 0.0f);
+        set("StepCount" + id, (float)o.stepCount);
+        set("PulseCount" + id, (float)o.pulseCount);
+        set("OutputNote" + id, (float)o.outputNote);
+        set("iOctave" + id, (float)o.octave);
+        set("ClockRate" + id, (float)o.clockRate);
+        set("Rotation" + id, (float)o.rotation);
+        set("Channel" + id, (float)o.channel);
+        set("GateMode" + id, o.gateInMs ? 1.0f : 0.0f);
+        set("GateLength" + id, (float)o.gatePercent);
+        set("GateTime" + id, (float)o.gateMs);
+
+        limitLanes(o);
+        velocityLanes[i] = o.velocity;
+        probabilityLanes[i] = o.probability;
+        ratchetLanes[i] = o.ratchet;
+    }
+
+    randomSeed = state.seed;
+    markOrbitsDirty(allOrbits);
+}
 
-    if (xmlState.get() != nullptr)
-        if (xmlState->hasTagName(treeState.state.getType()))
-            treeState.replaceState(juce::ValueTree::fromXml(*xmlState));
-    
+//==============================================================================
+PatternExport::Settings NewProjectAudioProcessor::getPatternExportSettings(int numBars, int midiFileType) const
+{
+    PatternExport::Settings settings;
+
+    for (int i = 0; i < numOrbits; i++)
+    {
+        settings.layout[i] = makeOrbitLayout(i);
+        settings.rotation[i] = (int)(*orbitParams[i].rotation);
+    }
 
+    settings.groove = currentGroove();
+    settings.lookaheadMs = *lookaheadParam;
+    settings.stepQuarters = getStepQuarters(parameterSettings());
+    settings.bpm = bpm;
+    settings.numerator = numerator;
+    settings.denominator = denominator;
+    settings.numBars = numBars;
+    settings.midiFileType = midiFileType;
+    return settings;
+}
+
+bool NewProjectAudioProcessor::exportPattern(juce::OutputStream& destination, int numBars, int midiFileType) const
+{
+    return PatternExport::write(getPatternExportSettings(numBars, midiFileType), destination);
+}
+
+bool NewProjectAudioProcessor::exportPattern(const juce::File& destination, int numBars, int midiFileType) const
+{
+    return PatternExport::write(getPatternExportSettings(numBars, midiFileType), destination);
 }
 
 //==============================================================================
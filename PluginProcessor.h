@@ -9,21 +9,42 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "SequencerConfig.h"
+#include "EuclideanPattern.h"
+#include "EventTimeline.h"
+#include "PatternExport.h"
+#include "StateFormat.h"
+#include "PresetBank.h"
+#include "SnapshotPublisher.h"
+#include "NoteScheduler.h"
+#include "MidiDelayLine.h"
+#include "OrbitStateChannel.h"
+#include "ProcessorInstrumentation.h"
+#include "RealtimeAudit.h"
 
 //==============================================================================
 /**
 */
-class NewProjectAudioProcessor : public juce::AudioProcessor
+class NewProjectAudioProcessor : public juce::AudioProcessor,
+    private juce::AudioProcessorValueTreeState::Listener,
+    private juce::Timer
 {
 public:
     //==============================================================================
-    NewProjectAudioProcessor();
+    explicit NewProjectAudioProcessor(const juce::File& bankFile = PresetBank::getDefaultFile());
     ~NewProjectAudioProcessor() override;
 
 
     juce::AudioProcessorValueTreeState treeState;
-    std::vector<int> currentStep;
-    bool cycleChanged;
+    std::array<int, numOrbits> currentStep {};
+    TripleBuffer<OrbitDisplayState> displayChannel; // audio thread -> editor, polled by OrbitPanel
+    ProcessStatistics statistics;                   // only updated when EUCLID_INSTRUMENTATION is on
+
+    // the most one block can send: every note started may end one sounding on its pitch, start and end, and
+    // so may every booking still pending, every voice may be let go and all the input held back come out.
+    // a MidiBuffer keeps a short message behind its time and size
+    static constexpr int maxOutputEvents = 3 * (maxNotesPerBlock + maxVoices) + maxVoices + maxDelayedMessages;
+    static constexpr int outputMidiBytes = maxOutputEvents * (int)(sizeof(juce::int32) + sizeof(juce::uint16) + 3);
 
     
     //==============================================================================
@@ -34,31 +55,6 @@ public:
 #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
 #endif
-    int noteToInt(juce::String s)
-    {
-        int noteValue = 0;
-        char c = s[0];
-       
-        switch (c)
-        {
-           
-            case 'C': noteValue = 60; break;
-            case 'D': noteValue = 62; break;
-            case 'E': noteValue = 64; break;
-            case 'F': noteValue = 65; break;
-            case 'G': noteValue = 67; break;
-            case 'A': noteValue = 69; break;
-            case 'B': noteValue = 71; break;
-            default: noteValue = 100; break;
-        }
-
-        if(s.contains("#"))
-        {
-            noteValue += 1;
-        }
-
-        return noteValue;
-    }
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
 
     //==============================================================================
@@ -84,23 +80,218 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
+    // appends the current settings to the preset bank as a new program
+    bool saveCurrentAsPreset(const juce::String& name);
+
+    // per-step lanes and the seed their probabilities are drawn with, message thread only
+    void setStepVelocity(int orbit, int step, int velocity);
+    void setStepProbability(int orbit, int step, int percent);
+    void setStepRatchet(int orbit, int step, int repeats);
+    int getStepVelocity(int orbit, int step) const;
+    int getStepProbability(int orbit, int step) const;
+    int getStepRatchet(int orbit, int step) const;
+    void setRandomSeed(juce::uint32 seed);
+    juce::uint32 getRandomSeed() const          { return randomSeed; }
+
+    // a groove template replaces Swing until it's cleared with an empty one, message thread only
+    void setGrooveTemplate(const Groove::Template& groove);
+    const Groove::Template& getGrooveTemplate() const  { return customGroove; }
+
+    //==============================================================================
+    // offline export of the current pattern, message thread (or any non-audio thread) only.
+    // uses the last tempo and time signature the host reported
+    PatternExport::Settings getPatternExportSettings(int numBars, int midiFileType = 1) const;
+    bool exportPattern(juce::OutputStream& destination, int numBars, int midiFileType = 1) const;
+    bool exportPattern(const juce::File& destination, int numBars, int midiFileType = 1) const;
+
 private:
     //==============================================================================
 
     //juce::AudioProcessorValueTreeState treeState;
 
+    // raw parameter handles, looked up once in the constructor so processBlock never builds ID strings
+    struct OrbitParameters
+    {
+        std::atomic<float>* stepCount = nullptr;
+        std::atomic<float>* pulseCount = nullptr;
+        std::atomic<float>* reversed = nullptr;
+        std::atomic<float>* octave = nullptr;
+        std::atomic<float>* clockRate = nullptr;
+        std::atomic<float>* onButton = nullptr;
+        std::atomic<float>* rotation = nullptr;
+        std::atomic<float>* outputNote = nullptr;     // choice index, semitones above C4
+        std::atomic<float>* channel = nullptr;
+        std::atomic<float>* gateMode = nullptr;
+        std::atomic<float>* gateLength = nullptr;
+        std::atomic<float>* gateTime = nullptr;
+    };
+
+    // the settings that aren't per orbit, as the audio thread plays them
+    struct GlobalSettings
+    {
+        float speed = 0.4f;
+        bool sync = false, dot = true, trip = false;
+        bool quantizeToBar = false;     // pattern changes wait for the bar line rather than the next step
+        bool midiThru = true, followInput = false, retrigger = false;
+    };
+
+    // a program the audio thread has switched to, with everything it's played with, until the message
+    // thread has copied it into the parameters and published a timeline of its own
+    struct ProgramSnapshot
+    {
+        EventTimeline timeline;
+        GlobalSettings settings;
+        std::array<int, numOrbits> rotation {};     // left out of the timeline like the parameter's
+        int index = 0;
+    };
+
+    // every preset in the bank, built on the message thread so a program change only swaps a pointer.
+    // nullptr for one that couldn't be read
+    struct ProgramSet
+    {
+        int size = 0;
+        std::array<std::unique_ptr<ProgramSnapshot>, PresetBank::maxPresets> programs;
+    };
+
+    // everything the step scheduler needs to know about the current block
+    struct BlockTiming
+    {
+        juce::int64 blockStart = 0;     // samplesPlayed at the start of the block
+        int startSample = 0;            // the part of the block being rendered, split at incoming events
+        int endSample = 0;
+        double stepSamples = 1.0;       // one global step, in samples
+        double stepQuarters = 1.0;      // one global step, in quarter notes
+        double samplesPerQuarter = 1.0;
+        double barQuarters = 4.0;
+        GlobalSettings settings;        // what the block is played with, see currentSettings()
+        double ppq = 0.0;               // host position at the start of the block
+        bool hasPosition = false;       // the host reports where it is
+        bool transportLocked = false;   // Sync is on and the host reports a position
+        bool playing = false;           // ...and its transport is running
+        bool continuing = false;        // ...and was already running, without a jump, last block
+    };
+
+    void resolveParameterHandles();
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void timerCallback() override;
+    void rebuildTimeline(juce::uint32 dirty);
+    Groove::Template currentGroove() const;
+    void updateLatency();
+    void updateGrooveTable(double stepSamples);
+    EventTimeline::OrbitLayout makeOrbitLayout(int orbit) const;
+    static EventTimeline::OrbitLayout makeOrbitLayout(const StateFormat::OrbitRecord& o, juce::uint32 seed, int orbit);
+    GlobalSettings parameterSettings() const;
+    GlobalSettings currentSettings() const;
+    double getStepQuarters(const GlobalSettings& settings) const;
+    void applySettings(BlockTiming& timing);
+    StateFormat::OrbitRecord captureOrbit(int orbit) const;
+    StateFormat::State captureState() const;
+    void applyState(const StateFormat::State& state);
+    void loadProgram(int index);
+    void publishPrograms();
+    static void buildProgram(const StateFormat::State& state, int index, ProgramSnapshot& program);
+    void queueProgram(int index);
+    void prepareNextProgram();
+    const EventTimeline& currentTimeline() const noexcept;
+    const EventTimeline* fetchPendingTimeline();
+    const EventTimeline& commitPendingTimeline();
+    std::vector<PresetBank::Preset> readPresets() const;
+    bool writePresets(const std::vector<PresetBank::Preset>& bank);
+    int renderUntil(juce::MidiBuffer& processedMidi, BlockTiming& timing, int endSample);
+    int renderSegment(juce::MidiBuffer& processedMidi, const BlockTiming& timing);
+    int renderTimeline(juce::MidiBuffer& processedMidi, const BlockTiming& timing);
+    int renderOrbitClocks(const EventTimeline& timeline, juce::MidiBuffer& processedMidi, const BlockTiming& timing);
+    int followingStep(int orbit, const EventTimeline::OrbitLayout& layout) const;
+    void handleInputEvent(const juce::MidiMessageMetadata& event, const BlockTiming& timing);
+    void restartOrbits(double now);
+    int heldNoteFor(int orbit) const;
+    static juce::int64 nextBoundaryTick(juce::int64 tick, const BlockTiming& timing);
+    static void retimeClock(double& origin, juce::int64& originIndex, double& stepSamples, double newStepSamples, double now);
+    static juce::int64 floorDivide(juce::int64 a, juce::int64 b);
+    void advanceOrbit(int orbit, juce::MidiBuffer& processedMidi, int offset, const EventTimeline::OrbitLayout& layout,
+                      double stepSamples, int step, juce::int64 tick);
+    void markOrbitsDirty(juce::uint32 orbitMask);
+
+    std::array<OrbitParameters, numOrbits> orbitParams;
+    std::atomic<float>* speedParam = nullptr;
+    std::atomic<float>* syncParam = nullptr;
+    std::atomic<float>* dotParam = nullptr;
+    std::atomic<float>* tripParam = nullptr;
+    std::atomic<float>* quantizeParam = nullptr;
+    std::atomic<float>* thruParam = nullptr;
+    std::atomic<float>* followParam = nullptr;
+    std::atomic<float>* retriggerParam = nullptr;
+    std::atomic<float>* swingParam = nullptr;
+    std::atomic<float>* lookaheadParam = nullptr;
+
+    OrbitDisplayState displayState;
+
     juce::AudioPlayHead::CurrentPositionInfo playHeadInfo;
 
-    int tempo, time, numerator;
-    int ntDrtn;
+    // last tempo seen from the host, also read by the exporter
+    std::atomic<double> bpm { 120.0 };
+    std::atomic<int> numerator { 4 }, denominator { 4 };
+    double expectedPpq = 0.0;   // where the host should be at the start of the next block
+    bool wasPlaying = false;
     float rate;
-    float syncSpeed;
-    int steps;
-    int pulses;
-    bool done = false;
-    std::vector <std::vector<bool>> orbits;
-    std::vector<int> cycleSteps;
-    juce::SortedSet<int> notes; //might need to be vector if noteOffs aren't catching multiples
+    // per-orbit playback state, one array per field so the per-block clock loops stay vectorisable
+    std::array<juce::int64, numOrbits> nextStepIndex {}; // absolute index of each orbit's next boundary
+    std::array<double, numOrbits> orbitOrigin {};        // free-running: sample step orbitOriginIndex falls on...
+    std::array<juce::int64, numOrbits> orbitOriginIndex {};
+    std::array<double, numOrbits> orbitStepSamples {};   // ...and the step length the rest follow at, 0 until known
+
+    SnapshotPublisher<EventTimeline> timelines;   // every orbit's pattern, rebuilt on the message thread, walked by processBlock
+    std::atomic<juce::uint32> dirtyOrbits { 0 };  // bit i set when orbit i's parameters changed since the last rebuild
+    std::array<EventTimeline::OrbitLayout, numOrbits> orbitLayout; // message thread's copy of the last published layout
+    std::array<StepLanes::Lane, numOrbits> velocityLanes;          // not parameters, saved with the state
+    std::array<StepLanes::Lane, numOrbits> probabilityLanes;
+    std::array<StepLanes::Lane, numOrbits> ratchetLanes;
+    juce::uint32 randomSeed = 0;
+    Groove::Template customGroove;                // empty unless a template was loaded
+    std::atomic<bool> grooveChanged { false };
+    std::atomic<int> lookaheadSamples { 0 };      // what the host was last told the latency is
+
+    // the current snapshot's groove in samples, rebuilt only when the groove, the step length or the lookahead changes
+    Groove::Table grooveTable;
+    bool grooveTableStale = true;
+    double grooveStepSamples = 0.0;
+    int grooveLookahead = 0;
+    double timelineOrigin = 0.0;                  // free-running: sample timelineOriginTick falls on...
+    juce::int64 timelineOriginTick = 0;
+    double timelineSamplesPerTick = 0.0;          // ...and the tick length the rest follow at, 0 until known
+    juce::int64 nextTimelineTick = 0;             // transport-locked: tick of the first event not fired yet
+    NoteScheduler scheduledNotes;                  // notes still to start or end, and when
+    MidiDelayLine delayedThru;                     // input passed through, held back as long as the notes
+    juce::int64 samplesPlayed = 0;                 // since prepareToPlay, the time base note-offs are booked in
+    std::array<juce::uint32, 4> heldNotes {};      // bit n set while note n is held on the input
+    bool followInput = false;                      // FollowInput, read once per block and at a program change
+    juce::MidiBuffer outputMidi;     // reserved in prepareToPlay, swapped with the host buffer every block
+    int notesLeftInBlock = maxNotesPerBlock;
+
+    juce::File presetFile;
+    PresetBank presets;                              // memory-mapped, only touched on the message thread
+    int currentProgram = 0;
+    SnapshotPublisher<ProgramSet> programs;          // the bank, decoded for the audio thread
+
+    // programs are switched on the audio thread at a step boundary, one per boundary in the order they arrived,
+    // whether they came in as MIDI program changes or from the host
+    juce::AbstractFifo programRequests { 32 };      // message thread -> audio thread, from setCurrentProgram()
+    std::array<int, 32> requestedPrograms {};
+    std::array<int, 32> queuedPrograms {};          // audio thread only, oldest first
+    int firstQueued = 0, numQueued = 0;
+    const ProgramSnapshot* pendingProgram = nullptr; // the next program, waiting for a boundary
+    const ProgramSnapshot* activeProgram = nullptr;  // the one playing, nullptr once the parameters have caught up
+    int switchedAt = -1;                            // sample in the block a program took over at, -1 if none
+    bool programStarting = false;                   // ...and it hasn't played its first step yet
+    juce::uint32 programSequence = 0;               // audio thread: programs switched to so far
+    std::atomic<juce::uint64> switchedProgram { 0 }; // ...and the last one, sequence << 32 | index, for the timer
+    juce::uint32 appliedProgramSequence = 0;        // message thread: the last of them copied into the parameters
+    std::atomic<bool> preparedToPlay { false };
+
+    std::atomic<juce::uint64> stateGeneration { 0 }; // bumped on every parameter change
+    juce::CriticalSection stateLock;
+    juce::MemoryBlock cachedState;                   // last blob getStateInformation built...
+    juce::uint64 cachedStateGeneration = 0;          // ...and the generation it was built from
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NewProjectAudioProcessor)
 };
\ No newline at end of file
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    A bank of presets in one memory-mapped file of fixed-size records.
+
+  ==============================================================================
+*/
+
+#include "PresetBank.h"
+
+bool PresetBank::open(const juce::File& file)
+{
+    close();
+
+    if (! file.existsAsFile())
+        return false;
+
+    auto mapped = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    auto* data = static_cast<const char*>(mapped->getData());
+    auto fileSize = (juce::int64)mapped->getSize();
+
+    if (data == nullptr || fileSize < headerSize || juce::ByteOrder::littleEndianInt(data) != magic)
+        return false;
+
+    auto storedHeader = (int)juce::ByteOrder::littleEndianShort(data + 6);
+    auto storedRecord = (int)juce::ByteOrder::littleEndianShort(data + 8);
+    auto storedCount = (juce::int64)juce::ByteOrder::littleEndianInt(data + 12);
+
+    // records of other sizes are fine, the state blob in each says what it holds
+    if (storedHeader < headerSize || storedRecord <= nameBytes
+         || fileSize < storedHeader + storedCount * storedRecord)
+        return false;
+
+    mapping = std::move(mapped);
+    storedHeaderSize = storedHeader;
+    storedRecordSize = storedRecord;
+    numPresets = (int)juce::jmin((juce::int64)maxPresets, storedCount);
+    return true;
+}
+
+void PresetBank::close()
+{
+    mapping.reset();
+    numPresets = 0;
+}
+
+const char* PresetBank::getRecord(int index) const noexcept
+{
+    if (! juce::isPositiveAndBelow(index, numPresets))
+        return nullptr;
+
+    return static_cast<const char*>(mapping->getData()) + storedHeaderSize + (size_t)index * (size_t)storedRecordSize;
+}
+
+juce::String PresetBank::getName(int index) const
+{
+    if (auto* record = getRecord(index))
+    {
+        auto length = 0;
+
+        while (length < nameBytes && record[length] != 0)
+            length++;
+
+        return juce::String::fromUTF8(record, length);
+    }
+
+    return {};
+}
+
+bool PresetBank::getState(int index, StateFormat::State& state) const
+{
+    if (auto* record = getRecord(index))
+        return StateFormat::read(record + nameBytes, storedRecordSize - nameBytes, state);
+
+    return false;
+}
+
+//==============================================================================
+bool PresetBank::write(const juce::File& file, const std::vector<Preset>& presets)
+{
+    auto count = juce::jmin((int)presets.size(), maxPresets);
+    juce::MemoryBlock bank, state;
+
+    {
+        juce::MemoryOutputStream out(bank, false);
+
+        out.writeInt((int)magic);
+        out.writeShort((short)version);
+        out.writeShort((short)headerSize);
+        out.writeShort((short)recordSize);
+        out.writeShort(0);
+        out.writeInt(count);
+
+        for (int i = 0; i < count; i++)
+        {
+            auto* name = presets[(size_t)i].name.toRawUTF8();
+            auto nameLength = (int)strlen(name);
+
+            // names are cut at nameBytes, keeping whole UTF-8 characters
+            if (nameLength > nameBytes)
+            {
+                nameLength = nameBytes;
+
+                while (nameLength > 0 && (name[nameLength] & 0xc0) == 0x80)
+                    nameLength--;
+            }
+
+            StateFormat::write(presets[(size_t)i].state, state);
+
+            out.write(name, (size_t)nameLength);
+            out.writeRepeatedByte(0, (size_t)(nameBytes - nameLength));
+            out.write(state.getData(), state.getSize());
+            out.writeRepeatedByte(0, (size_t)(recordSize - nameBytes) - state.getSize());
+        }
+    }
+
+    return file.getParentDirectory().createDirectory() && file.replaceWithData(bank.getData(), bank.getSize());
+}
+
+juce::File PresetBank::getDefaultFile()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile(JucePlugin_Name)
+        .getChildFile("Presets.eucb");
+}
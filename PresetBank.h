@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+
+    A bank of presets in one memory-mapped file of fixed-size records.
+
+    Layout (little-endian):
+
+        header, headerSize bytes
+            uint32  magic "EUCB"
+            uint16  version
+            uint16  headerSize
+            uint16  recordSize
+            uint16  reserved
+            uint32  number of records
+
+        then one recordSize record per preset
+            nameBytes of UTF-8 name, zero padded
+            a StateFormat blob, zero padded
+
+    Presets are decoded straight from the mapping, never through XML.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StateFormat.h"
+
+//==============================================================================
+class PresetBank
+{
+public:
+    static constexpr juce::uint32 magic = 0x42435545;   // "EUCB"
+    static constexpr int version = 1;
+    static constexpr int headerSize = 16;
+    static constexpr int nameBytes = 32;
+    static constexpr int recordSize = (nameBytes + StateFormat::blobSize + 63) / 64 * 64;
+    static constexpr int maxPresets = 128;              // one per MIDI program number
+
+    struct Preset
+    {
+        juce::String name;
+        StateFormat::State state;
+    };
+
+    PresetBank() = default;
+
+    //==============================================================================
+    // maps the file, returns false (leaving the bank empty) if it's missing or not a bank
+    bool open(const juce::File& file);
+    void close();
+
+    int size() const noexcept                   { return numPresets; }
+    juce::String getName(int index) const;
+    bool getState(int index, StateFormat::State& state) const;
+
+    //==============================================================================
+    // replaces the file with the given presets, which must not be open in any bank
+    static bool write(const juce::File& file, const std::vector<Preset>& presets);
+
+    static juce::File getDefaultFile();
+
+private:
+    const char* getRecord(int index) const noexcept;
+
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    int numPresets = 0;
+    int storedRecordSize = recordSize;
+    int storedHeaderSize = headerSize;
+
+    JUCE_DECLARE_NON_COPYABLE(PresetBank)
+};
@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+    Lightweight counters for profiling processBlock outside of a debugger.
+
+    Enabled whenever EUCLID_INSTRUMENTATION is non-zero: by default in debug
+    builds of the plugin, and always in the bench, soak and test targets.
+    The audio thread is the only writer of the block counters; anything may
+    read the totals at any time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "RealtimeAudit.h"
+
+#ifndef EUCLID_INSTRUMENTATION
+ #if JUCE_DEBUG
+  #define EUCLID_INSTRUMENTATION 1
+ #else
+  #define EUCLID_INSTRUMENTATION 0
+ #endif
+#endif
+
+//==============================================================================
+struct ProcessStatistics
+{
+    std::atomic<juce::int64> blocks { 0 };
+    std::atomic<juce::int64> samples { 0 };
+    std::atomic<juce::int64> totalTicks { 0 };
+    std::atomic<juce::int64> worstTicks { 0 };
+    std::atomic<juce::int64> eventsEmitted { 0 };
+    std::atomic<juce::int64> stepsFired { 0 };
+    std::atomic<juce::int64> stateCacheHits { 0 };
+    std::atomic<juce::int64> stateRebuilds { 0 };
+    std::array<juce::int64, 3> violationsAtReset = getViolationCounts();
+
+    // audio thread only
+    void addBlock(juce::int64 ticks, int numSamples, int numEvents, int numSteps) noexcept
+    {
+        blocks.store(blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        samples.store(samples.load(std::memory_order_relaxed) + numSamples, std::memory_order_relaxed);
+        totalTicks.store(totalTicks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+        eventsEmitted.store(eventsEmitted.load(std::memory_order_relaxed) + numEvents, std::memory_order_relaxed);
+        stepsFired.store(stepsFired.load(std::memory_order_relaxed) + numSteps, std::memory_order_relaxed);
+
+        if (ticks > worstTicks.load(std::memory_order_relaxed))
+            worstTicks.store(ticks, std::memory_order_relaxed);
+    }
+
+    // whichever thread the host saves state from
+    void addStateRequest(bool cacheHit) noexcept
+    {
+        (cacheHit ? stateCacheHits : stateRebuilds).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    double getAverageNanosPerBlock() const noexcept
+    {
+        auto n = blocks.load(std::memory_order_relaxed);
+        return n > 0 ? ticksToNanos(totalTicks.load(std::memory_order_relaxed)) / (double)n : 0.0;
+    }
+
+    double getWorstNanosPerBlock() const noexcept
+    {
+        return ticksToNanos(worstTicks.load(std::memory_order_relaxed));
+    }
+
+    double getPerBlock(juce::int64 count) const noexcept
+    {
+        auto n = blocks.load(std::memory_order_relaxed);
+        return n > 0 ? (double)count / (double)n : 0.0;
+    }
+
+    // not safe to call while the audio thread is running
+    void reset() noexcept
+    {
+        blocks = 0;
+        samples = 0;
+        totalTicks = 0;
+        worstTicks = 0;
+        eventsEmitted = 0;
+        stepsFired = 0;
+        stateCacheHits = 0;
+        stateRebuilds = 0;
+        violationsAtReset = getViolationCounts();
+    }
+
+    // allocations, frees or locks inside a realtime section since the last reset, by any instance.
+    // always 0 unless built with EUCLID_REALTIME_AUDIT
+    juce::int64 getViolationCount(RealtimeAudit::Violation kind) const noexcept
+    {
+        return RealtimeAudit::getViolationCount(kind) - violationsAtReset[(size_t)kind];
+    }
+
+    juce::int64 getAllocationCount() const noexcept    { return getViolationCount(RealtimeAudit::Violation::allocation); }
+    juce::int64 getFreeCount() const noexcept          { return getViolationCount(RealtimeAudit::Violation::free); }
+    juce::int64 getLockCount() const noexcept          { return getViolationCount(RealtimeAudit::Violation::lock); }
+
+    juce::String toString() const
+    {
+        return "blocks: " + juce::String(blocks.load())
+             + ", avg ns/block: " + juce::String(getAverageNanosPerBlock(), 1)
+             + ", worst ns/block: " + juce::String(getWorstNanosPerBlock(), 1)
+             + ", events: " + juce::String(eventsEmitted.load())
+             + ", events/block: " + juce::String(getPerBlock(eventsEmitted.load()), 2)
+             + ", steps: " + juce::String(stepsFired.load())
+             + ", state cache hits: " + juce::String(stateCacheHits.load())
+             + ", state rebuilds: " + juce::String(stateRebuilds.load())
+             + ", allocations/block: " + juce::String(getPerBlock(getAllocationCount()), 3)
+             + ", frees/block: " + juce::String(getPerBlock(getFreeCount()), 3)
+             + ", locks/block: " + juce::String(getPerBlock(getLockCount()), 3);
+    }
+
+    // every instance's so far, one for each kind of RealtimeAudit::Violation
+    static std::array<juce::int64, 3> getViolationCounts() noexcept
+    {
+        return { RealtimeAudit::getViolationCount(RealtimeAudit::Violation::allocation),
+                 RealtimeAudit::getViolationCount(RealtimeAudit::Violation::free),
+                 RealtimeAudit::getViolationCount(RealtimeAudit::Violation::lock) };
+    }
+
+    static double ticksToNanos(juce::int64 ticks) noexcept
+    {
+        return juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9;
+    }
+};
@@ -0,0 +1,208 @@
+/*
+  ==============================================================================
+
+    Real-time safety audit for the audio callback.
+
+  ==============================================================================
+*/
+
+#include "RealtimeAudit.h"
+
+#if EUCLID_REALTIME_AUDIT
+
+#include <cstdlib>
+#include <new>
+
+// with glibc the C allocator and pthread_mutex_lock are replaced too, so allocations made by C code
+// or by the standard library behind operator new's back are caught, and so is taking a lock
+#if defined (__GLIBC__)
+ #define EUCLID_AUDIT_LIBC 1
+ #include <cerrno>
+ #include <dlfcn.h>
+ #include <pthread.h>
+
+ extern "C"
+ {
+     void* __libc_malloc(size_t);
+     void* __libc_calloc(size_t, size_t);
+     void* __libc_realloc(void*, size_t);
+     void* __libc_memalign(size_t, size_t);
+     void __libc_free(void*);
+ }
+#else
+ #define EUCLID_AUDIT_LIBC 0
+#endif
+
+// the audit state is read from inside malloc, so it must not live in TLS that is itself allocated on first use
+#if defined (__GNUC__)
+ #define EUCLID_STATIC_TLS __attribute__((tls_model("initial-exec")))
+#else
+ #define EUCLID_STATIC_TLS
+#endif
+
+namespace RealtimeAudit
+{
+    namespace
+    {
+        thread_local int realtimeDepth EUCLID_STATIC_TLS = 0;
+        thread_local bool reporting EUCLID_STATIC_TLS = false; // logging a violation allocates too, don't report that
+        std::array<std::atomic<juce::int64>, 3> violations {};
+    }
+
+    ScopedRealtimeSection::ScopedRealtimeSection() noexcept   { ++realtimeDepth; }
+    ScopedRealtimeSection::~ScopedRealtimeSection() noexcept  { --realtimeDepth; }
+
+    bool isInsideRealtimeSection() noexcept
+    {
+        return realtimeDepth > 0 && ! reporting;
+    }
+
+    void reportViolation(Violation kind, const char* what) noexcept
+    {
+        violations[(size_t)kind].fetch_add(1, std::memory_order_relaxed);
+
+        reporting = true;
+        juce::Logger::outputDebugString(juce::String("Real-time violation in processBlock: ") + what + "\n"
+                                        + juce::SystemStats::getStackBacktrace());
+        reporting = false;
+
+        jassertfalse;
+    }
+
+    juce::int64 getViolationCount(Violation kind) noexcept
+    {
+        return violations[(size_t)kind].load(std::memory_order_relaxed);
+    }
+}
+
+//==============================================================================
+namespace
+{
+    using RealtimeAudit::Violation;
+
+    void audit(Violation kind, const char* what) noexcept
+    {
+        if (RealtimeAudit::isInsideRealtimeSection())
+            RealtimeAudit::reportViolation(kind, what);
+    }
+
+   #if EUCLID_AUDIT_LIBC
+    // operator new and delete go through the replaced malloc and free below, which do the reporting
+    void* auditedAllocate(std::size_t size, const char*) noexcept   { return malloc(size == 0 ? 1 : size); }
+    void auditedFree(void* p, const char*) noexcept                 { free(p); }
+   #else
+    void* auditedAllocate(std::size_t size, const char* what) noexcept
+    {
+        audit(Violation::allocation, what);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void auditedFree(void* p, const char* what) noexcept
+    {
+        if (p != nullptr)
+            audit(Violation::free, what);
+
+        std::free(p);
+    }
+   #endif
+}
+
+#if EUCLID_AUDIT_LIBC
+extern "C"
+{
+    void* malloc(size_t size) noexcept
+    {
+        audit(Violation::allocation, "malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size) noexcept
+    {
+        audit(Violation::allocation, "calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, size_t size) noexcept
+    {
+        audit(Violation::allocation, "realloc");
+        return __libc_realloc(p, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) noexcept
+    {
+        audit(Violation::allocation, "memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        audit(Violation::allocation, "aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size) noexcept
+    {
+        audit(Violation::allocation, "posix_memalign");
+
+        if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        *result = __libc_memalign(alignment, size);
+        return *result != nullptr ? 0 : ENOMEM;
+    }
+
+    void free(void* p) noexcept
+    {
+        if (p != nullptr)
+            audit(Violation::free, "free");
+
+        __libc_free(p);
+    }
+
+    // a lock taken on the audio thread can wait on whichever thread holds it
+    int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+    {
+        using LockFunction = int (*)(pthread_mutex_t*);
+        static std::atomic<LockFunction> next { nullptr };
+
+        auto lock = next.load(std::memory_order_relaxed);
+
+        if (lock == nullptr)
+        {
+            lock = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+            next.store(lock, std::memory_order_relaxed);
+        }
+
+        audit(Violation::lock, "pthread_mutex_lock");
+        return lock(mutex);
+    }
+}
+#endif
+
+void* operator new(std::size_t size)
+{
+    if (auto* p = auditedAllocate(size, "operator new"))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    if (auto* p = auditedAllocate(size, "operator new[]"))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept    { return auditedAllocate(size, "operator new"); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept  { return auditedAllocate(size, "operator new[]"); }
+
+void operator delete(void* p) noexcept                                  { auditedFree(p, "operator delete"); }
+void operator delete[](void* p) noexcept                                { auditedFree(p, "operator delete[]"); }
+void operator delete(void* p, std::size_t) noexcept                     { auditedFree(p, "operator delete"); }
+void operator delete[](void* p, std::size_t) noexcept                   { auditedFree(p, "operator delete[]"); }
+void operator delete(void* p, const std::nothrow_t&) noexcept           { auditedFree(p, "operator delete"); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept         { auditedFree(p, "operator delete[]"); }
+
+#endif
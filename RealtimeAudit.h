@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+    Real-time safety audit for the audio callback.
+
+    Build with EUCLID_REALTIME_AUDIT=1 to replace the global allocation
+    operators: any operator new/delete issued on a thread that is inside a
+    ScopedRealtimeSection is logged with a stack trace, counted, and trips
+    a jassert. With glibc, malloc and friends, free and pthread_mutex_lock
+    are replaced as well. Allocations, frees and locks are counted apart.
+    With the flag off (the default) everything here compiles to nothing.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef EUCLID_REALTIME_AUDIT
+ #define EUCLID_REALTIME_AUDIT 0
+#endif
+
+namespace RealtimeAudit
+{
+    enum class Violation
+    {
+        allocation,
+        free,
+        lock
+    };
+
+#if EUCLID_REALTIME_AUDIT
+    // marks the calling thread as running real-time code for the lifetime of the object
+    struct ScopedRealtimeSection
+    {
+        ScopedRealtimeSection() noexcept;
+        ~ScopedRealtimeSection() noexcept;
+    };
+
+    bool isInsideRealtimeSection() noexcept;
+    void reportViolation(Violation kind, const char* what) noexcept;
+    juce::int64 getViolationCount(Violation kind) noexcept;
+#else
+    struct ScopedRealtimeSection
+    {
+        ScopedRealtimeSection() noexcept {}
+    };
+
+    inline bool isInsideRealtimeSection() noexcept { return false; }
+    inline void reportViolation(Violation, const char*) noexcept {}
+    inline juce::int64 getViolationCount(Violation) noexcept { return 0; }
+#endif
+}
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    Compile-time sizing of the sequencer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// number of orbits (independent Euclidean voices) per instance. every orbit gets its own
+// set of parameters, so changing this changes the plugin's parameter list
+#ifndef EUCLID_NUM_ORBITS
+ #define EUCLID_NUM_ORBITS 5
+#endif
+
+constexpr int numOrbits = EUCLID_NUM_ORBITS;
+
+// orbit sets are passed around as one bit per orbit
+static_assert(numOrbits >= 1 && numOrbits <= 32, "EUCLID_NUM_ORBITS must be between 1 and 32");
+
+constexpr juce::uint32 allOrbits = numOrbits >= 32 ? 0xffffffffu : ((juce::uint32)1 << numOrbits) - 1;
+
+// the lowest orbit in a set that isn't empty, so a set can be walked one member at a time with
+// for (auto bits = set; bits != 0; bits &= bits - 1) { auto i = countTrailingZeros(bits); ... }
+inline int countTrailingZeros(juce::uint32 bits) noexcept
+{
+    jassert(bits != 0);
+
+   #if defined (__GNUC__) || defined (__clang__)
+    return __builtin_ctz(bits);
+   #elif defined (_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (int)index;
+   #else
+    return juce::countNumberOfBits((bits & (0u - bits)) - 1);
+   #endif
+}
+
+// notes that may sound at once, across all orbits. starting another one ends the note due to end
+// soonest, which bounds the note-offs a single block can ever have to send
+#ifndef EUCLID_MAX_VOICES
+ #define EUCLID_MAX_VOICES 64
+#endif
+
+constexpr int maxVoices = EUCLID_MAX_VOICES;
+
+static_assert(maxVoices >= numOrbits, "EUCLID_MAX_VOICES must allow at least one note per orbit");
+
+// notes, ratchets included, the orbits may start in one block between them. at rates and block sizes
+// fast enough to go past it the remaining steps rest, which bounds what a block can ever send
+constexpr int maxNotesPerBlock = 1024;
+
+// the longest the output can be held back for a groove to pull notes early, and the input passed through
+// that can be held back with it: several times a controller every millisecond
+constexpr int maxLookaheadMs = 100;
+constexpr int maxDelayedMessages = 8 * maxLookaheadMs;
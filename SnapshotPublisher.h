@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    Hands large, immutable snapshots from the message thread to the audio
+    thread without locks or allocation on the audio side.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <thread>
+
+//==============================================================================
+/**
+    Four preallocated slots rotate between the writer, a pending hand-off and
+    the reader. The writer fills its slot and swaps it into 'pending'; the
+    reader fetches whatever is pending at a point of its choosing, keeps
+    using its current snapshot until it commits to the fetched one, and hands
+    slots it is done with back through 'retired'.
+
+    The reader never waits. The writer only ever waits for the two
+    instructions between the reader taking a pending slot and retiring the
+    one it replaces.
+*/
+template <typename SnapshotType>
+class SnapshotPublisher
+{
+public:
+    SnapshotPublisher()
+    {
+        for (auto& s : slots)
+            s = std::make_unique<SnapshotType>();
+
+        current = slots[0].get();
+        writing = slots[1].get();
+        retired[0].store(slots[2].get());
+        retired[1].store(slots[3].get());
+    }
+
+    //==============================================================================
+    // writer side (message thread). fill the returned object completely, then publish()
+    SnapshotType& beginWrite() noexcept     { return *writing; }
+
+    void publish() noexcept
+    {
+        if (auto* unread = pending.exchange(writing, std::memory_order_acq_rel))
+        {
+            writing = unread; // the reader never saw the previous one, reuse it
+            return;
+        }
+
+        for (;;)
+        {
+            for (auto& r : retired)
+            {
+                if (auto* spare = r.exchange(nullptr, std::memory_order_acq_rel))
+                {
+                    writing = spare;
+                    return;
+                }
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+    //==============================================================================
+    // reader side (audio thread). takes the newest published snapshot without switching to it,
+    // returns nullptr if nothing has been published since the last commit()
+    const SnapshotType* fetch() noexcept
+    {
+        if (auto* next = pending.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            if (fetched != nullptr)
+                retire(fetched);
+
+            fetched = next;
+        }
+
+        return fetched;
+    }
+
+    // switches to the fetched snapshot, if there is one
+    const SnapshotType& commit() noexcept
+    {
+        if (fetched != nullptr)
+        {
+            retire(current);
+            current = fetched;
+            fetched = nullptr;
+        }
+
+        return *current;
+    }
+
+    // returns the newest published snapshot
+    const SnapshotType& acquire() noexcept
+    {
+        fetch();
+        return commit();
+    }
+
+    // the snapshot the reader is currently using, without looking for a newer one
+    const SnapshotType& get() const noexcept  { return *current; }
+
+private:
+    // at most two slots are ever retired at once, so one of the two places is always free
+    void retire(SnapshotType* s) noexcept
+    {
+        auto& r = retired[0].load(std::memory_order_relaxed) == nullptr ? retired[0] : retired[1];
+        jassert(r.load(std::memory_order_relaxed) == nullptr);
+        r.store(s, std::memory_order_release);
+    }
+
+    std::unique_ptr<SnapshotType> slots[4];
+    SnapshotType* current = nullptr;    // reader only
+    SnapshotType* fetched = nullptr;    // reader only
+    SnapshotType* writing = nullptr;    // writer only
+    std::atomic<SnapshotType*> pending { nullptr };
+    std::atomic<SnapshotType*> retired[2];
+
+    JUCE_DECLARE_NON_COPYABLE(SnapshotPublisher)
+};
@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+    The plugin's saved state, as a compact versioned binary blob.
+
+  ==============================================================================
+*/
+
+#include "StateFormat.h"
+
+namespace
+{
+    // sizes of the version 1 header and orbit record, the smallest any blob may use
+    constexpr int headerSizeV1 = 20;
+    constexpr int orbitRecordSizeV1 = 8;
+
+    enum GlobalFlags { syncFlag = 1, dotFlag = 2, tripFlag = 4, quantizeToBarFlag = 8,
+                       // stored inverted, so blobs from before it existed keep passing input through
+                       thruOffFlag = 16, followInputFlag = 32, retriggerFlag = 64 };
+    enum OrbitFlags { onFlag = 1, reversedFlag = 2 };
+}
+
+void StateFormat::write(const State& state, juce::MemoryBlock& destData)
+{
+    destData.setSize(0);
+    juce::MemoryOutputStream out(destData, false);
+
+    out.writeInt((int)magic);
+    out.writeShort((short)currentVersion);
+    out.writeShort((short)headerSize);
+    out.writeShort((short)orbitRecordSize);
+    out.writeShort((short)numOrbits);
+    out.writeFloat(state.speed);
+    out.writeByte((char)((state.sync ? syncFlag : 0) | (state.dot ? dotFlag : 0) | (state.trip ? tripFlag : 0)
+                            | (state.quantizeToBar ? quantizeToBarFlag : 0) | (state.midiThru ? 0 : thruOffFlag)
+                            | (state.followInput ? followInputFlag : 0) | (state.retrigger ? retriggerFlag : 0)));
+    out.writeRepeatedByte(0, 3);
+    out.writeInt((int)state.seed);
+    out.writeFloat(state.swing);
+    out.writeFloat(state.lookaheadMs);
+    out.writeByte((char)state.groove.length);
+    out.writeRepeatedByte(0, 3);
+
+    for (auto offset : state.groove.offsets)
+        out.writeShort((short)juce::roundToInt(offset * 1000.0f));
+
+    for (auto& o : state.orbits)
+    {
+        out.writeByte((char)((o.on ? onFlag : 0) | (o.reversed ? reversedFlag : 0)));
+        out.writeByte((char)o.stepCount);
+        out.writeByte((char)o.pulseCount);
+        out.writeByte((char)o.outputNote);
+        out.writeByte((char)o.octave);
+        out.writeByte((char)o.clockRate);
+        out.writeByte((char)o.rotation);
+        out.writeByte((char)(o.channel - 1));
+        out.write(o.velocity.data(), o.velocity.size());
+        out.write(o.probability.data(), o.probability.size());
+        out.writeByte((char)(o.gateInMs ? 1 : 0));
+        out.writeByte((char)o.gatePercent);
+        out.writeShort((short)o.gateMs);
+        out.write(o.ratchet.data(), o.ratchet.size());
+    }
+}
+
+bool StateFormat::isBinaryState(const void* data, int sizeInBytes)
+{
+    return data != nullptr && sizeInBytes >= 4 && juce::ByteOrder::littleEndianInt(data) == magic;
+}
+
+bool StateFormat::read(const void* data, int sizeInBytes, State& state)
+{
+    if (! isBinaryState(data, sizeInBytes) || sizeInBytes < headerSizeV1)
+        return false;
+
+    juce::MemoryInputStream in(data, (size_t)sizeInBytes, false);
+    in.skipNextBytes(4);
+
+    auto version = (int)(juce::uint16)in.readShort();
+    auto headerSize = (int)(juce::uint16)in.readShort();
+    auto recordSize = (int)(juce::uint16)in.readShort();
+    auto numRecords = (int)(juce::uint16)in.readShort();
+
+    if (version < 1 || headerSize < headerSizeV1 || recordSize < orbitRecordSizeV1
+         || sizeInBytes < headerSize + numRecords * recordSize)
+        return false;
+
+    State loaded;
+    loaded.speed = in.readFloat();
+
+    auto flags = (int)(juce::uint8)in.readByte();
+    loaded.sync = (flags & syncFlag) != 0;
+    loaded.dot = (flags & dotFlag) != 0;
+    loaded.trip = (flags & tripFlag) != 0;
+    loaded.quantizeToBar = (flags & quantizeToBarFlag) != 0;
+    loaded.midiThru = (flags & thruOffFlag) == 0;
+    loaded.followInput = (flags & followInputFlag) != 0;
+    loaded.retrigger = (flags & retriggerFlag) != 0;
+
+    if (headerSize >= headerSizeV1 + 4)
+    {
+        in.skipNextBytes(3);
+        loaded.seed = (juce::uint32)in.readInt();
+    }
+
+    if (headerSize >= headerSizeV1 + 16 + 2 * Groove::maxLength)
+    {
+        loaded.swing = in.readFloat();
+        loaded.lookaheadMs = in.readFloat();
+        loaded.groove.length = juce::jmin((int)(juce::uint8)in.readByte(), Groove::maxLength);
+        in.skipNextBytes(3);
+
+        for (auto& offset : loaded.groove.offsets)
+            offset = in.readShort() / 1000.0f;
+    }
+
+    // blobs saved with more orbits than this build has lose the extra ones
+    for (int i = 0; i < juce::jmin(numRecords, numOrbits); i++)
+    {
+        auto& o = loaded.orbits[i];
+        in.setPosition(headerSize + i * recordSize);
+
+        auto orbitFlags = (int)(juce::uint8)in.readByte();
+        o.on = (orbitFlags & onFlag) != 0;
+        o.reversed = (orbitFlags & reversedFlag) != 0;
+        o.stepCount = (juce::uint8)in.readByte();
+        o.pulseCount = (juce::uint8)in.readByte();
+        o.outputNote = (juce::uint8)in.readByte();
+        o.octave = (juce::int8)in.readByte();
+        o.clockRate = (juce::uint8)in.readByte();
+        o.rotation = (juce::uint8)in.readByte();  // reserved, so zero, before rotation existed
+        o.channel = ((juce::uint8)in.readByte() & 15) + 1;   // likewise, channel 1
+
+        if (recordSize >= orbitRecordSizeV1 + 2 * EuclideanPattern::maxSteps)
+        {
+            in.read(o.velocity.data(), (int)o.velocity.size());
+            in.read(o.probability.data(), (int)o.probability.size());
+        }
+
+        if (recordSize >= orbitRecordSizeV1 + 2 * EuclideanPattern::maxSteps + 4)
+        {
+            o.gateInMs = in.readByte() != 0;
+            o.gatePercent = juce::jlimit(1, 100, (int)(juce::uint8)in.readByte());
+            o.gateMs = juce::jlimit(1, 2000, (int)(juce::uint16)in.readShort());
+        }
+
+        if (recordSize >= orbitRecordSizeV1 + 3 * EuclideanPattern::maxSteps + 4)
+            in.read(o.ratchet.data(), (int)o.ratchet.size());
+    }
+
+    state = loaded;
+    return true;
+}
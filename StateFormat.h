@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    The plugin's saved state, as a compact versioned binary blob.
+
+    Layout (all values little-endian):
+
+        header, headerSize bytes
+            uint32  magic "EUCS"
+            uint16  version
+            uint16  headerSize
+            uint16  orbitRecordSize
+            uint16  number of orbit records
+            float32 speed
+            uint8   flags: 1 sync, 2 dot, 4 trip, 8 quantize to bar,
+                    16 input not passed through, 32 follow input, 64 retrigger
+            3 bytes reserved
+            uint32  random seed                         (version 2)
+            float32 swing, percent                      (version 5)
+            float32 lookahead, ms                       (version 5)
+            uint8   groove template length, 0 for none  (version 5)
+            3 bytes reserved
+            int16   offset of each of the 32 template steps,
+                    thousandths of a step               (version 5)
+
+        then one record of orbitRecordSize bytes per orbit
+            uint8   flags: 1 on, 2 reversed
+            uint8   step count
+            uint8   pulse count
+            uint8   output note (choice index)
+            int8    octave
+            uint8   clock rate (choice index)
+            uint8   rotation
+            uint8   midi channel - 1
+            uint8   velocity of each of the 32 steps    (version 2)
+            uint8   probability of each step, percent   (version 2)
+            uint8   gate mode: 0 percent of step, 1 ms (version 3)
+            uint8   gate length, percent                (version 3)
+            uint16  gate time, ms                       (version 3)
+            uint8   ratchets of each step, 1-8          (version 4)
+
+    New fields only ever go on the end of the header or of a record, and the
+    sizes are stored, so any version can skip what it doesn't know about.
+    Fields an older blob doesn't have keep the defaults below. No field has
+    changed meaning since version 1; one that does gets converted in read(),
+    by the version the blob was saved with.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SequencerConfig.h"
+#include "StepLanes.h"
+#include "Groove.h"
+
+namespace StateFormat
+{
+    constexpr juce::uint32 magic = 0x53435545;  // "EUCS"
+    constexpr int currentVersion = 5;
+
+    // sizes the current version writes
+    constexpr int headerSize = 36 + 2 * Groove::maxLength;
+    constexpr int orbitRecordSize = 8 + 2 * EuclideanPattern::maxSteps + 4 + EuclideanPattern::maxSteps;
+    constexpr int blobSize = headerSize + orbitRecordSize * numOrbits;
+
+    // defaults match the parameter layout
+    struct OrbitRecord
+    {
+        bool on = false;
+        bool reversed = false;
+        int stepCount = 8;
+        int pulseCount = 3;
+        int outputNote = 0;
+        int octave = 0;
+        int clockRate = 5;  // "1"
+        int rotation = 0;
+        int channel = 1;
+        bool gateInMs = false;
+        int gatePercent = 100;
+        int gateMs = 250;
+        StepLanes::Lane velocity = StepLanes::filled(StepLanes::defaultVelocity);
+        StepLanes::Lane probability = StepLanes::filled(StepLanes::alwaysPlays);
+        StepLanes::Lane ratchet = StepLanes::filled(1);
+    };
+
+    struct State
+    {
+        float speed = 0.4f;
+        bool sync = false;
+        bool dot = true;
+        bool trip = false;
+        bool quantizeToBar = false;
+        bool midiThru = true;
+        bool followInput = false;
+        bool retrigger = false;
+        juce::uint32 seed = 0;
+        float swing = 50.0f;
+        float lookaheadMs = 0.0f;
+        Groove::Template groove;
+        std::array<OrbitRecord, numOrbits> orbits;
+    };
+
+    //==============================================================================
+    void write(const State& state, juce::MemoryBlock& destData);
+
+    // true if the data starts like one of our blobs (rather than the XML states older versions saved)
+    bool isBinaryState(const void* data, int sizeInBytes);
+
+    // returns false, leaving 'state' untouched, if the data is truncated or not ours
+    bool read(const void* data, int sizeInBytes, State& state);
+}
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    Per-step velocity, trigger probability and ratchets.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "EuclideanPattern.h"
+
+namespace StepLanes
+{
+    constexpr juce::uint8 defaultVelocity = 84;
+    constexpr juce::uint8 alwaysPlays = 100;    // probabilities are in percent
+    constexpr juce::uint8 maxRatchets = 8;      // times a step may repeat its note
+
+    using Lane = std::array<juce::uint8, EuclideanPattern::maxSteps>;
+
+    constexpr Lane filled(juce::uint8 value) noexcept
+    {
+        Lane lane {};
+
+        for (auto& v : lane)
+            v = value;
+
+        return lane;
+    }
+
+    //==============================================================================
+    constexpr juce::uint64 mix(juce::uint64 z) noexcept
+    {
+        z += 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    static_assert(mix(0) == 0xe220a8397b1dcdafull, "should match the reference SplitMix64");
+
+    // each orbit draws from its own stream
+    constexpr juce::uint64 orbitSeed(juce::uint32 seed, int orbit) noexcept
+    {
+        return mix(((juce::uint64)seed << 32) | (juce::uint32)orbit);
+    }
+
+    constexpr juce::uint32 random(juce::uint64 orbitSeed, juce::uint64 counter) noexcept
+    {
+        return (juce::uint32)(mix(orbitSeed ^ mix(counter)) >> 32);
+    }
+
+    // true if a pulse with this probability plays at 'counter'
+    constexpr bool plays(juce::uint8 probability, juce::uint64 orbitSeed, juce::uint64 counter) noexcept
+    {
+        return probability >= alwaysPlays
+            || (((juce::uint64)random(orbitSeed, counter) * alwaysPlays) >> 32) < probability;
+    }
+}
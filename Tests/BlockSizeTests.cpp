@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    Every step has to come out on the same sample whatever block size the
+    host calls processBlock with, on the flattened timeline and on the
+    per-orbit clocks, synced to the host or free-running.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    const int blockSizes[] { 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+
+    struct Scenario
+    {
+        const char* name;
+        bool sync;
+        bool trip;
+        bool orbitClocks;       // a combined cycle too long to flatten
+        double sampleRate;
+        double bpm;
+    };
+
+    const Scenario scenarios[]
+    {
+        { "synced timeline",                  true,  false, false, 44100.0, 120.0 },
+        { "synced timeline, triplets",        true,  true,  false, 48000.0, 133.0 },
+        { "synced orbit clocks",              true,  false, true,  44100.0, 120.0 },
+        { "free-running timeline",            false, false, false, 44100.0, 120.0 },
+        { "free-running orbit clocks",        false, true,  true,  96000.0, 97.0 },
+    };
+}
+
+//==============================================================================
+class BlockSizeTests : public juce::UnitTest
+{
+public:
+    BlockSizeTests() : juce::UnitTest("Block size independence", "Euclid") {}
+
+    void runTest() override
+    {
+        ProcessorHarness harness;
+        const auto minutes = 3.0;
+
+        for (auto& scenario : scenarios)
+        {
+            beginTest(scenario.name);
+
+            harness.setParameter("Sync", scenario.sync ? 1.0f : 0.0f);
+            harness.setParameter("Speed", scenario.sync ? 0.94f : 0.4f);   // synced: 1/16 notes
+            harness.setParameter("Dot", 0.0f);
+            harness.setParameter("Trip", scenario.trip ? 1.0f : 0.0f);
+
+            const int steps[] { 29, 31, 23, 19, 17 };
+
+            for (int i = 0; i < numOrbits; i++)
+            {
+                if (scenario.orbitClocks)
+                    harness.setOrbit(i, true, steps[i % 5], 7, (1 + 3 * i) % 11);
+                else
+                    harness.setOrbit(i, true, 8 + i, 3 + i, (2 + 2 * i) % 11);
+            }
+
+            harness.settle();
+
+            auto numSamples = (juce::int64)(minutes * 60.0 * scenario.sampleRate);
+            auto reference = render(harness, scenario, numSamples, blockSizes[0]);
+            expect(reference.size() > 100, "nothing was played");
+
+            for (auto blockSize : blockSizes)
+                expectSameEvents(reference, render(harness, scenario, numSamples, blockSize), blockSize);
+        }
+    }
+
+private:
+    static std::vector<RenderedEvent> render(ProcessorHarness& harness, const Scenario& scenario, juce::int64 numSamples, int blockSize)
+    {
+        std::vector<RenderedEvent> events;
+        harness.prepare(scenario.sampleRate, blockSize);
+        harness.playHead.info.bpm = scenario.bpm;
+        harness.render(numSamples, blockSize, &events);
+        return events;
+    }
+
+    void expectSameEvents(const std::vector<RenderedEvent>& expected, const std::vector<RenderedEvent>& actual, int blockSize)
+    {
+        auto blocks = " with " + juce::String(blockSize) + "-sample blocks";
+        auto count = juce::jmin(expected.size(), actual.size());
+        auto mismatch = std::mismatch(expected.begin(), expected.begin() + (long)count, actual.begin());
+
+        if (mismatch.first != expected.begin() + (long)count)
+            expect(false, "expected " + mismatch.first->toString() + ", got " + mismatch.second->toString() + blocks);
+
+        expectEquals((int)actual.size(), (int)expected.size(), "event count" + blocks);
+    }
+};
+
+static BlockSizeTests blockSizeTests;
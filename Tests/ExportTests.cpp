@@ -0,0 +1,161 @@
+/*
+  ==============================================================================
+
+    The MIDI file export has to hold exactly what the plugin plays over the
+    same bars: same steps, same ratchets and gates, the same groove, and the
+    same note-off sent early when one orbit restarts a pitch another is
+    still holding.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    // at 120 bpm and 48 kHz a file tick is a whole 25 samples, so both sides land on the same grid
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr juce::int64 samplesPerFileTick = 25;
+    constexpr int numBars = 2;
+}
+
+//==============================================================================
+class ExportTests : public juce::UnitTest
+{
+public:
+    ExportTests() : juce::UnitTest("Pattern export", "Euclid") {}
+
+    void runTest() override
+    {
+        ProcessorHarness harness;
+        harness.setParameter("Sync", 1.0f);
+        harness.setParameter("Speed", 0.94f);
+        harness.setParameter("Dot", 0.0f);
+        harness.setParameter("Trip", 0.0f);
+
+        // two orbits on one pitch, the second ratcheted and held long enough to run into the first
+        harness.setOrbit(0, true, 16, 5);
+        harness.setOrbit(1, true, 12, 7);
+        harness.setOrbit(2, true, 7, 3);
+
+        for (int i = 3; i < numOrbits; i++)
+            harness.setOrbit(i, false, 8, 0);
+
+        for (int i = 0; i < 2; i++)
+        {
+            auto id = juce::String(i + 1);
+            harness.setParameter("OutputNote" + id, 0.0f);
+            harness.setParameter("iOctave" + id, 0.0f);
+            harness.setParameter("Channel" + id, 1.0f);
+        }
+
+        harness.setParameter("GateLength1", 50.0f);
+        harness.setParameter("GateLength2", 100.0f);
+        harness.setParameter("GateMode3", 1.0f);
+        harness.setParameter("GateTime3", 25.0f);
+        harness.processor.setStepRatchet(1, 0, 3);
+        harness.processor.setStepRatchet(1, 5, 2);
+        harness.processor.setStepProbability(2, 1, 50);
+        harness.processor.setStepVelocity(0, 3, 64);
+        harness.settle();
+
+        beginTest("Export matches playback");
+        expectMatchesPlayback(harness, 0);
+
+        // every other step pulled early, further than the lookahead lets it go
+        beginTest("Export matches playback with a groove and a lookahead");
+        {
+            Groove::Template groove;
+            groove.length = 2;
+            groove.offsets[1] = -0.25f;
+            harness.processor.setGrooveTemplate(groove);
+            harness.setParameter("Lookahead", 12.5f);
+            harness.settle();
+
+            expectMatchesPlayback(harness, 24 * samplesPerFileTick);
+
+            harness.processor.setGrooveTemplate({});
+            harness.setParameter("Lookahead", 0.0f);
+            harness.settle();
+        }
+
+        beginTest("Each orbit gets its own track");
+        {
+            auto file = PatternExport::render(harness.processor.getPatternExportSettings(numBars, 1));
+            expectEquals(file.getNumTracks(), 1 + numOrbits);
+
+            // every note-on on a track is followed by its own note-off on that same track
+            for (int t = 1; t < file.getNumTracks(); t++)
+            {
+                std::array<int, 128> sounding {};
+                auto& track = *file.getTrack(t);
+
+                for (int i = 0; i < track.getNumEvents(); i++)
+                {
+                    auto& message = track.getEventPointer(i)->message;
+
+                    if (message.isNoteOn())
+                        sounding[(size_t)message.getNoteNumber()]++;
+                    else if (message.isNoteOff())
+                        expect(--sounding[(size_t)message.getNoteNumber()] >= 0, "a note-off on the wrong track");
+                }
+            }
+        }
+    }
+
+private:
+    // what's played over the first bars, less the latency the lookahead adds, is what's exported
+    void expectMatchesPlayback(ProcessorHarness& harness, juce::int64 lookaheadSamples)
+    {
+        harness.prepare(sampleRate, blockSize);
+
+        auto endSamples = numBars * 4 * 24000;
+        std::vector<RenderedEvent> played;
+        harness.render(endSamples + lookaheadSamples + blockSize, blockSize, &played);
+
+        for (auto& e : played)
+            e.time -= lookaheadSamples;
+
+        played.erase(std::remove_if(played.begin(), played.end(), [endSamples](auto& e) { return e.time >= endSamples; }),
+                     played.end());
+
+        auto file = PatternExport::render(harness.processor.getPatternExportSettings(numBars, 0));
+        auto exported = notesIn(file, endSamples);
+
+        expect(played.size() > 20, "nothing was played");
+        expectEquals((int)exported.size(), (int)played.size(), "the export has a different number of notes");
+
+        for (size_t i = 0; i < juce::jmin(played.size(), exported.size()); i++)
+            if (exported[i] != played[i])
+            {
+                expect(false, "played " + played[i].toString() + ", exported " + exported[i].toString());
+                break;
+            }
+    }
+
+    // the notes in a type 0 file, in samples, as the harness records what's played
+    static std::vector<RenderedEvent> notesIn(const juce::MidiFile& file, juce::int64 endSamples)
+    {
+        std::vector<RenderedEvent> events;
+        auto& track = *file.getTrack(0);
+
+        for (int i = 0; i < track.getNumEvents(); i++)
+        {
+            auto& message = track.getEventPointer(i)->message;
+            RenderedEvent e;
+            e.time = (juce::int64)message.getTimeStamp() * samplesPerFileTick;
+            e.numBytes = message.getRawDataSize();
+
+            if ((! message.isNoteOn() && ! message.isNoteOff()) || e.time >= endSamples)
+                continue;
+
+            std::copy(message.getRawData(), message.getRawData() + e.numBytes, e.bytes.begin());
+            events.push_back(e);
+        }
+
+        return events;
+    }
+};
+
+static ExportTests exportTests;
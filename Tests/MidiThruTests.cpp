@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    Input passed through while a lookahead holds the output back comes out
+    exactly that much later, in the order it came in, and however dense it
+    is it never takes the place of a note the orbits play.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    // one orbit playing every 1/16 at 120 bpm, everything held back 100 ms
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr juce::int64 lookaheadSamples = 4800;
+    constexpr juce::int64 runSamples = 2 * 96000;
+    constexpr int inputChannel = 16;
+
+    bool isInput(const RenderedEvent& e)    { return (e.bytes[0] & 0x0f) == inputChannel - 1; }
+}
+
+//==============================================================================
+class MidiThruTests : public juce::UnitTest
+{
+public:
+    MidiThruTests() : juce::UnitTest("MIDI thru", "Euclid") {}
+
+    void runTest() override
+    {
+        ProcessorHarness harness;
+        harness.setParameter("Sync", 1.0f);
+        harness.setParameter("Speed", 0.94f);
+        harness.setParameter("Dot", 0.0f);
+        harness.setParameter("Trip", 0.0f);
+        harness.setParameter("Lookahead", 100.0f);
+        harness.setOrbit(0, true, 16, 16);
+
+        for (int i = 1; i < numOrbits; i++)
+            harness.setOrbit(i, false, 8, 0);
+
+        harness.settle();
+
+        harness.prepare(sampleRate, blockSize);
+        std::vector<RenderedEvent> alone;
+        harness.render(runSamples, blockSize, &alone);
+
+        beginTest("A controller every millisecond under the lookahead");
+        {
+            harness.prepare(sampleRate, blockSize);
+            std::vector<juce::int64> sent;
+
+            for (juce::int64 time = 0; time < runSamples; time += 48)
+            {
+                harness.addInput(time, juce::MidiMessage::controllerEvent(inputChannel, 1, (int)(sent.size() % 128)));
+                sent.push_back(time);
+            }
+
+            std::vector<RenderedEvent> played;
+            harness.render(runSamples, blockSize, &played);
+
+            std::vector<RenderedEvent> notes, passed;
+
+            for (auto& e : played)
+                (isInput(e) ? passed : notes).push_back(e);
+
+            // every note the orbit plays on its own, untouched
+            expect(! alone.empty());
+            expect(notes == alone, "the notes changed with the input passed through");
+
+            // and every controller, the lookahead late and in order, up to the end of the run
+            auto numDue = (size_t)std::count_if(sent.begin(), sent.end(), [](auto t) { return t + lookaheadSamples < runSamples; });
+            expectEquals((int)passed.size(), (int)numDue);
+
+            for (size_t i = 0; i < juce::jmin(passed.size(), numDue); i++)
+                if (passed[i].time != sent[i] + lookaheadSamples || passed[i].bytes[2] != (juce::uint8)(i % 128))
+                {
+                    expect(false, "controller " + juce::String((int)i) + " came out as " + passed[i].toString());
+                    break;
+                }
+        }
+    }
+};
+
+static MidiThruTests midiThruTests;
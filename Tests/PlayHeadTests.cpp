@@ -0,0 +1,235 @@
+/*
+  ==============================================================================
+
+    A synced sequencer has to tell a host that drifts from one that has
+    moved the transport: drifting forward by less than a tick keeps every
+    note playing out, while going back, or forward by more, lets go of
+    whatever is sounding and starts again from the new position. It stays
+    on the host's beats through tempo changes and long runs at fractional
+    tempos, and lets go of every note when the transport stops.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    // one orbit playing every 1/16 at 120 bpm: a step is 6000 samples, a tick 500, each note half a step
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+    constexpr juce::int64 stepSamples = 6000;
+    constexpr juce::int64 tickSamples = stepSamples / EventTimeline::ticksPerStep;
+    constexpr juce::int64 gateSamples = stepSamples / 2;
+    constexpr double quartersPerSample = 120.0 / (60.0 * sampleRate);
+
+    std::vector<RenderedEvent> noteOns(const std::vector<RenderedEvent>& events)
+    {
+        std::vector<RenderedEvent> result;
+        std::copy_if(events.begin(), events.end(), std::back_inserter(result), [](auto& e) { return e.isNoteOn(); });
+        return result;
+    }
+}
+
+//==============================================================================
+class PlayHeadTests : public juce::UnitTest
+{
+public:
+    PlayHeadTests() : juce::UnitTest("Host play head", "Euclid") {}
+
+    void runTest() override
+    {
+        ProcessorHarness harness;
+        harness.setParameter("Sync", 1.0f);
+        harness.setParameter("Speed", 0.94f);
+        harness.setParameter("Dot", 0.0f);
+        harness.setParameter("Trip", 0.0f);
+        harness.setParameter("GateLength1", 50.0f);
+        harness.setOrbit(0, true, 16, 16);
+
+        for (int i = 1; i < numOrbits; i++)
+            harness.setOrbit(i, false, 8, 0);
+
+        harness.settle();
+
+        beginTest("Drift under a tick");
+        {
+            harness.prepare(sampleRate, blockSize);
+            auto random = getRandom();
+            std::vector<RenderedEvent> events;
+
+            // at most one jump ahead between any two steps
+            for (int block = 0; block < 8000; block++)
+            {
+                if (block % 32 == 31)
+                    harness.relocate(harness.getPpqAt(harness.getPosition())
+                                     + random.nextDouble() * 0.9 * (double)tickSamples * quartersPerSample);
+
+                harness.processBlock(blockSize, &events);
+            }
+
+            auto ons = noteOns(events);
+            expect(ons.size() > 100, "nothing was played");
+
+            // nothing let go early or restarted: every note lasts its gate, and the steps only close up by the drift
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                if (! events[i].isNoteOn() || events[i].time + gateSamples >= harness.getPosition())
+                    continue;
+
+                auto off = std::find_if(events.begin() + (long)i, events.end(), [](auto& e) { return e.isNoteOff(); });
+                expect(off != events.end() && off->time - events[i].time == gateSamples,
+                       "note at " + juce::String(events[i].time) + " was cut short");
+            }
+
+            for (size_t i = 1; i < ons.size(); i++)
+            {
+                auto interval = ons[i].time - ons[i - 1].time;
+                expect(interval > stepSamples - tickSamples && interval <= stepSamples,
+                       "steps " + juce::String(interval) + " samples apart at " + juce::String(ons[i].time));
+            }
+        }
+
+        beginTest("Going back a few samples");
+        expectRelocation(harness, -3.0 * quartersPerSample);
+
+        beginTest("Going forward more than a tick");
+        expectRelocation(harness, 2.0 * (double)tickSamples * quartersPerSample);
+
+        beginTest("Looping back a bar");
+        expectRelocation(harness, -4.0);
+
+        // from mid-way through a step, the steps carry on along the host's beats at the new tempo
+        beginTest("Changing tempo mid-bar");
+        {
+            harness.prepare(sampleRate, blockSize);
+
+            std::vector<RenderedEvent> events;
+            harness.render(2 * stepSamples + stepSamples / 3, blockSize, &events);
+
+            auto changedAt = harness.getPosition();
+            auto changedAtPpq = harness.getPpqAt(changedAt);
+            harness.setTempo(90.0);
+
+            events.clear();
+            harness.render(8 * stepSamples, blockSize, &events);
+
+            auto ons = noteOns(events);
+            expectEquals((int)ons.size(), 6);
+            expectOnGrid(ons, changedAt, changedAtPpq, stepSamples * quartersPerSample, 90.0);
+            harness.setTempo(120.0);
+        }
+
+        // a fractional tempo and triplet steps: a step is 4266.67 samples, and minutes on the last one is still on the grid
+        beginTest("A fractional tempo for minutes");
+        {
+            harness.setParameter("Trip", 1.0f);
+            harness.settle();
+            harness.prepare(sampleRate, blockSize);
+            harness.playHead.info.bpm = 112.5;
+
+            std::vector<RenderedEvent> events;
+            events.reserve(100000);
+            harness.render(3 * 60 * (juce::int64)sampleRate, blockSize, &events);
+
+            auto ons = noteOns(events);
+            expectEquals((int)ons.size(), 2025);     // 337.5 quarters, six steps each
+            expectOnGrid(ons, 0, 0.0, stepSamples * quartersPerSample * 2.0 / 3.0, 112.5);
+
+            harness.playHead.info.bpm = 120.0;
+            harness.setParameter("Trip", 0.0f);
+            harness.settle();
+        }
+
+        // a second orbit holds its notes longer, both are sounding when the host stops
+        beginTest("Stopping lets go of every note");
+        {
+            harness.setOrbit(1, true, 16, 16);
+            harness.setParameter("OutputNote2", 7.0f);
+            harness.setParameter("GateLength2", 100.0f);
+            harness.settle();
+            harness.prepare(sampleRate, blockSize);
+
+            std::vector<RenderedEvent> events;
+            harness.render(4 * stepSamples + 1000, blockSize, &events);
+
+            auto stoppedAt = harness.getPosition();
+            harness.setPlaying(false);
+            harness.render(4 * stepSamples, blockSize, &events);
+
+            std::array<int, 128> sounding {};
+            auto offsAtStop = 0;
+
+            for (auto& e : events)
+            {
+                if (e.isNoteOn())
+                {
+                    expect(e.time < stoppedAt, "note started after the stop at " + e.toString());
+                    sounding[(size_t)e.bytes[1]]++;
+                }
+                else if (e.isNoteOff())
+                {
+                    expect(e.time <= stoppedAt, "note let go late at " + e.toString());
+                    offsAtStop += e.time == stoppedAt ? 1 : 0;
+                    sounding[(size_t)e.bytes[1]]--;
+                }
+            }
+
+            expectEquals(offsAtStop, 2);
+            expect(std::all_of(sounding.begin(), sounding.end(), [](int n) { return n == 0; }), "a note was left hanging");
+
+            harness.setPlaying(true);
+            harness.setOrbit(1, false, 8, 0);
+            harness.settle();
+        }
+    }
+
+private:
+    // every note starts within a sample of a step on the host's grid, counted from where it was at 'fromPpq', with none missed
+    void expectOnGrid(const std::vector<RenderedEvent>& ons, juce::int64 from, double fromPpq, double stepQuarters, double bpm)
+    {
+        auto samplesPerQuarter = 60.0 * sampleRate / bpm;
+        auto step = std::ceil(fromPpq / stepQuarters - 1.0e-9);
+
+        for (auto& on : ons)
+        {
+            auto expected = (double)from + (step++ * stepQuarters - fromPpq) * samplesPerQuarter;
+
+            if (std::abs((double)on.time - expected) > 1.0)
+            {
+                expect(false, "expected a step at " + juce::String(expected, 1) + ", got " + on.toString());
+                return;
+            }
+        }
+    }
+
+    // moves the transport by 'quarters' while a note sounds: it ends right there, and the
+    // next one starts on the grid measured from the new position
+    void expectRelocation(ProcessorHarness& harness, double quarters)
+    {
+        harness.prepare(sampleRate, blockSize);
+        harness.relocate(8.0);
+
+        std::vector<RenderedEvent> events;
+        harness.render(stepSamples + 4 * blockSize, blockSize, &events);
+
+        auto ppq = harness.getPpqAt(harness.getPosition()) + quarters;
+        auto relocatedAt = harness.getPosition();
+        harness.relocate(ppq);
+
+        events.clear();
+        harness.render(2 * stepSamples, blockSize, &events);
+
+        expect(! events.empty() && events.front().isNoteOff() && events.front().time == relocatedAt,
+               "the sounding note wasn't let go when the transport moved");
+
+        auto ons = noteOns(events);
+        auto stepQuarters = stepSamples * quartersPerSample;
+        auto nextStep = relocatedAt + (juce::int64)std::floor((std::ceil(ppq / stepQuarters - 1.0e-9) * stepQuarters - ppq) / quartersPerSample + 1.0e-6);
+
+        expect(! ons.empty() && ons.front().time == nextStep,
+               "expected the next step at " + juce::String(nextStep) + ", got " + (ons.empty() ? juce::String("none") : ons.front().toString()));
+    }
+};
+
+static PlayHeadTests playHeadTests;
@@ -0,0 +1,174 @@
+/*
+  ==============================================================================
+
+    Switching programs, from the host or as MIDI program changes, has to
+    play the old pattern right up to the next step (or bar) boundary and
+    the new one from there, exactly as the new preset plays when loaded on
+    its own, and go on doing so once the parameters have caught up.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    // synced at 120 bpm: a step is 6000 samples and a 4/4 bar 96000
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+    constexpr juce::int64 stepSamples = 6000;
+    constexpr juce::int64 barSamples = 16 * stepSamples;
+    constexpr juce::int64 runSamples = 3 * barSamples;
+
+    // one orbit playing, which each preset sets apart by its pattern, rotation and pitch
+    PresetBank::Preset makePreset(const juce::String& name, int steps, int pulses, int rotation, int outputNote,
+                                  bool quantizeToBar = false)
+    {
+        PresetBank::Preset preset;
+        preset.name = name;
+
+        auto& state = preset.state;
+        state.sync = true;
+        state.speed = 0.94f;
+        state.dot = false;
+        state.trip = false;
+        state.quantizeToBar = quantizeToBar;
+
+        // the others step in silence
+        for (auto& other : state.orbits)
+            other.pulseCount = 0;
+
+        auto& o = state.orbits[0];
+        o.on = true;
+        o.stepCount = steps;
+        o.pulseCount = pulses;
+        o.rotation = rotation;
+        o.outputNote = outputNote;
+        o.gatePercent = 50;
+        return preset;
+    }
+
+    std::vector<RenderedEvent> noteOns(const std::vector<RenderedEvent>& events)
+    {
+        std::vector<RenderedEvent> result;
+        std::copy_if(events.begin(), events.end(), std::back_inserter(result), [](auto& e) { return e.isNoteOn(); });
+        return result;
+    }
+
+    std::vector<RenderedEvent> between(const std::vector<RenderedEvent>& events, juce::int64 start, juce::int64 end)
+    {
+        std::vector<RenderedEvent> result;
+        std::copy_if(events.begin(), events.end(), std::back_inserter(result),
+                     [=](auto& e) { return e.time >= start && e.time < end; });
+        return result;
+    }
+}
+
+//==============================================================================
+class ProgramTests : public juce::UnitTest
+{
+public:
+    ProgramTests() : juce::UnitTest("Programs", "Euclid") {}
+
+    void runTest() override
+    {
+        juce::TemporaryFile bank(".eucb");
+        bankFile = bank.getFile();
+
+        expect(PresetBank::write(bankFile, { makePreset("Straight", 16, 16, 0, 0),
+                                             makePreset("Rotated", 16, 11, 2, 4),
+                                             makePreset("Sparse", 8, 3, 1, 7),
+                                             makePreset("Straight by bar", 16, 16, 0, 0, true) }));
+
+        std::vector<std::vector<RenderedEvent>> alone;
+
+        for (int i = 0; i < 4; i++)
+            alone.push_back(playAlone(i));
+
+        beginTest("Switching from the host");
+        {
+            ProcessorHarness harness(bankFile);
+            auto played = startWith(harness, 0);
+
+            // asked between steps, switched at the next one, and no different once the timer has caught up
+            harness.render(20000, blockSize, &played);
+            harness.processor.setCurrentProgram(1);
+            harness.render(barSamples - 20000, blockSize, &played);
+            harness.settle();
+            harness.render(runSamples - barSamples, blockSize, &played);
+
+            played = noteOns(played);
+            expectPlays(played, 0, 4 * stepSamples, alone[0]);
+            expectPlays(played, 4 * stepSamples, runSamples, alone[1]);
+            expectEquals(harness.processor.getCurrentProgram(), 1);
+            expectEquals((int)*harness.processor.treeState.getRawParameterValue("Rotation1"), 2);
+        }
+
+        beginTest("Program changes in one block take a step each");
+        {
+            ProcessorHarness harness(bankFile);
+            auto played = startWith(harness, 0);
+
+            harness.addInput(40000, juce::MidiMessage::programChange(1, 1));
+            harness.addInput(40001, juce::MidiMessage::programChange(1, 2));
+            harness.render(runSamples, blockSize, &played);
+
+            played = noteOns(played);
+            expectPlays(played, 0, 7 * stepSamples, alone[0]);
+            expectPlays(played, 7 * stepSamples, 8 * stepSamples, alone[1]);
+            expectPlays(played, 8 * stepSamples, runSamples, alone[2]);
+        }
+
+        beginTest("Switching on the bar");
+        {
+            ProcessorHarness harness(bankFile);
+            auto played = startWith(harness, 3);
+
+            harness.render(50000, blockSize, &played);
+            harness.processor.setCurrentProgram(1);
+            harness.render(runSamples - 50000, blockSize, &played);
+
+            played = noteOns(played);
+            expectPlays(played, 0, barSamples, alone[3]);
+            expectPlays(played, barSamples, runSamples, alone[1]);
+        }
+    }
+
+private:
+    // loaded before the processor is prepared, a program is copied into the parameters straight away
+    std::vector<RenderedEvent> startWith(ProcessorHarness& harness, int program)
+    {
+        harness.processor.setCurrentProgram(program);
+        harness.settle();
+        harness.prepare(sampleRate, blockSize);
+        return {};
+    }
+
+    std::vector<RenderedEvent> playAlone(int program)
+    {
+        ProcessorHarness harness(bankFile);
+        auto played = startWith(harness, program);
+        harness.render(runSamples, blockSize, &played);
+        return noteOns(played);
+    }
+
+    void expectPlays(const std::vector<RenderedEvent>& played, juce::int64 start, juce::int64 end,
+                     const std::vector<RenderedEvent>& expected)
+    {
+        auto a = between(played, start, end);
+        auto b = between(expected, start, end);
+        expect(! b.empty(), "nothing to compare between " + juce::String(start) + " and " + juce::String(end));
+        expectEquals((int)a.size(), (int)b.size(), "notes between " + juce::String(start) + " and " + juce::String(end));
+
+        for (size_t i = 0; i < juce::jmin(a.size(), b.size()); i++)
+            if (a[i] != b[i])
+            {
+                expect(false, "played " + a[i].toString() + ", expected " + b[i].toString());
+                break;
+            }
+    }
+
+    juce::File bankFile;
+};
+
+static ProgramTests programTests;
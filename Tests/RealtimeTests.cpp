@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    However fast the orbits step and however large the host's blocks, what
+    one block sends has to fit the output reserved for it, so processBlock
+    never grows a buffer. Built with EUCLID_REALTIME_AUDIT on, nothing in
+    it may allocate, free or lock either.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    // the fastest synced steps, every orbit at four times the rate and every step ratcheted as far as it goes
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 8192;
+    constexpr double bpm = 300.0;
+}
+
+//==============================================================================
+class RealtimeTests : public juce::UnitTest
+{
+public:
+    RealtimeTests() : juce::UnitTest("Realtime safety", "Euclid") {}
+
+    void runTest() override
+    {
+        ProcessorHarness harness;
+        harness.setParameter("Sync", 1.0f);
+        harness.setParameter("Speed", 1.0f);
+        harness.setParameter("Dot", 0.0f);
+        harness.setParameter("Trip", 1.0f);
+
+        for (int i = 0; i < numOrbits; i++)
+        {
+            harness.setOrbit(i, true, 16, 16, 10);
+            harness.setParameter("Channel" + juce::String(i + 1), (float)(i + 1));
+
+            for (int step = 0; step < EuclideanPattern::maxSteps; step++)
+                harness.processor.setStepRatchet(i, step, StepLanes::maxRatchets);
+        }
+
+        beginTest("Ratchets at the fastest rate in 8192-sample blocks");
+        expectFits(harness);
+
+        beginTest("The same under a lookahead");
+        harness.setParameter("Lookahead", 100.0f);
+        expectFits(harness);
+    }
+
+private:
+    void expectFits(ProcessorHarness& harness)
+    {
+        harness.settle();
+        harness.prepare(sampleRate, blockSize);
+        harness.playHead.info.bpm = bpm;
+
+        std::vector<RenderedEvent> events;
+        events.reserve(NewProjectAudioProcessor::maxOutputEvents);
+        auto mostInBlock = 0;
+        auto numNotes = 0;
+
+        for (int block = 0; block < 200; block++)
+        {
+            events.clear();
+            harness.processBlock(blockSize, &events);
+            mostInBlock = juce::jmax(mostInBlock, (int)events.size());
+            numNotes += (int)std::count_if(events.begin(), events.end(), [](auto& e) { return e.isNoteOn(); });
+        }
+
+        expect(numNotes >= 200 * maxVoices, "the orbits hardly played");
+        expect(mostInBlock <= NewProjectAudioProcessor::maxOutputEvents,
+               juce::String(mostInBlock) + " events in one block, room for " + juce::String(NewProjectAudioProcessor::maxOutputEvents));
+
+        auto& statistics = harness.processor.statistics;
+        expectEquals((int)statistics.getAllocationCount(), 0, "allocations in processBlock");
+        expectEquals((int)statistics.getFreeCount(), 0, "frees in processBlock");
+        expectEquals((int)statistics.getLockCount(), 0, "locks in processBlock");
+    }
+};
+
+static RealtimeTests realtimeTests;
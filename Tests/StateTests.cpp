@@ -0,0 +1,259 @@
+/*
+  ==============================================================================
+
+    A saved state has to come back exactly as it was saved, and sessions
+    saved by older versions have to keep loading: a binary blob from any
+    earlier version with what it lacks at the defaults, one from a newer
+    version without what this one doesn't know, and the XML the plugin
+    saved before there was a binary format.
+
+  ==============================================================================
+*/
+
+#include "ProcessorHarness.h"
+
+namespace
+{
+    // sizes each version wrote, header and orbit record, see StateFormat.h
+    struct VersionSizes { int version, headerSize, recordSize; };
+
+    constexpr VersionSizes olderVersions[] = { { 1, 20, 8 },
+                                               { 2, 24, 8 + 2 * EuclideanPattern::maxSteps },
+                                               { 3, 24, 12 + 2 * EuclideanPattern::maxSteps },
+                                               { 4, 24, 12 + 3 * EuclideanPattern::maxSteps } };
+
+    juce::MemoryBlock saveState(NewProjectAudioProcessor& processor)
+    {
+        juce::MemoryBlock blob;
+        processor.getStateInformation(blob);
+        return blob;
+    }
+
+    void loadState(NewProjectAudioProcessor& processor, const juce::MemoryBlock& blob)
+    {
+        processor.setStateInformation(blob.getData(), (int)blob.getSize());
+    }
+
+    // the current blob cut down, or padded out, to another version's header and record sizes
+    juce::MemoryBlock resize(const juce::MemoryBlock& blob, int version, int headerSize, int recordSize)
+    {
+        auto* data = static_cast<const char*>(blob.getData());
+        juce::MemoryBlock result;
+
+        {
+            juce::MemoryOutputStream out(result, false);
+
+            auto copy = [&](int offset, int size, int newSize)
+            {
+                out.write(data + offset, (size_t)juce::jmin(size, newSize));
+                out.writeRepeatedByte((juce::uint8)0xee, (size_t)juce::jmax(0, newSize - size));
+            };
+
+            out.writeInt((int)StateFormat::magic);
+            out.writeShort((short)version);
+            out.writeShort((short)headerSize);
+            out.writeShort((short)recordSize);
+            out.writeShort((short)numOrbits);
+            copy(12, StateFormat::headerSize - 12, headerSize - 12);
+
+            for (int i = 0; i < numOrbits; i++)
+                copy(StateFormat::headerSize + i * StateFormat::orbitRecordSize, StateFormat::orbitRecordSize, recordSize);
+        }
+
+        return result;
+    }
+
+    // what a state saved by 'version' keeps of 'state': everything added later is at its default
+    StateFormat::State keptBy(StateFormat::State state, int version)
+    {
+        const StateFormat::State defaults;
+        const StateFormat::OrbitRecord orbitDefaults;
+
+        if (version < 2)
+            state.seed = defaults.seed;
+
+        if (version < 5)
+        {
+            state.swing = defaults.swing;
+            state.lookaheadMs = defaults.lookaheadMs;
+            state.groove = defaults.groove;
+        }
+
+        for (auto& o : state.orbits)
+        {
+            if (version < 2)
+            {
+                o.velocity = orbitDefaults.velocity;
+                o.probability = orbitDefaults.probability;
+            }
+
+            if (version < 3)
+            {
+                o.gateInMs = orbitDefaults.gateInMs;
+                o.gatePercent = orbitDefaults.gatePercent;
+                o.gateMs = orbitDefaults.gateMs;
+            }
+
+            if (version < 4)
+                o.ratchet = orbitDefaults.ratchet;
+        }
+
+        return state;
+    }
+}
+
+//==============================================================================
+class StateTests : public juce::UnitTest
+{
+public:
+    StateTests() : juce::UnitTest("Saved state", "Euclid") {}
+
+    void runTest() override
+    {
+        ProcessorHarness saved;
+        changeEverything(saved);
+        auto blob = saveState(saved.processor);
+
+        beginTest("Round trip through the binary state");
+        {
+            expect(StateFormat::isBinaryState(blob.getData(), (int)blob.getSize()));
+            expectEquals((int)blob.getSize(), StateFormat::blobSize);
+
+            ProcessorHarness loaded;
+            loaded.processor.setStepRatchet(0, 0, 3);
+            loadState(loaded.processor, blob);
+
+            expect(saveState(loaded.processor) == blob, "the state saved again differs");
+            expectParametersMatch(loaded, saved);
+            expectEquals((int)loaded.processor.getRandomSeed(), 0x5eed);
+            expectEquals(loaded.processor.getStepVelocity(2, 5), 17);
+            expectEquals(loaded.processor.getStepProbability(3, 31), 40);
+            expectEquals(loaded.processor.getStepRatchet(0, 0), 1);
+            expectEquals(loaded.processor.getStepRatchet(1, 7), 6);
+            expectEquals(loaded.processor.getGrooveTemplate().length, 3);
+            expectEquals(loaded.processor.getGrooveTemplate().offsets[1], -0.125f);
+        }
+
+        beginTest("Blobs from older versions");
+        {
+            StateFormat::State full;
+            expect(StateFormat::read(blob.getData(), (int)blob.getSize(), full));
+
+            for (auto& sizes : olderVersions)
+            {
+                // loaded over the full state, so whatever the old blob lacks has to go back to its default
+                ProcessorHarness loaded;
+                loadState(loaded.processor, blob);
+                loadState(loaded.processor, resize(blob, sizes.version, sizes.headerSize, sizes.recordSize));
+
+                juce::MemoryBlock expected;
+                StateFormat::write(keptBy(full, sizes.version), expected);
+                expect(saveState(loaded.processor) == expected, "version " + juce::String(sizes.version) + " loaded differently");
+            }
+        }
+
+        beginTest("A blob from a newer version");
+        {
+            ProcessorHarness loaded;
+            loadState(loaded.processor, resize(blob, StateFormat::currentVersion + 1,
+                                               StateFormat::headerSize + 8, StateFormat::orbitRecordSize + 4));
+
+            expect(saveState(loaded.processor) == blob, "the fields it added weren't skipped");
+        }
+
+        beginTest("Truncated or foreign data changes nothing");
+        {
+            ProcessorHarness loaded;
+            loadState(loaded.processor, blob);
+
+            juce::MemoryBlock truncated(blob.getData(), blob.getSize() - 10);
+            loadState(loaded.processor, truncated);
+            expect(saveState(loaded.processor) == blob, "a truncated blob was loaded");
+
+            const char junk[] = "not a state";
+            loaded.processor.setStateInformation(junk, (int)sizeof(junk));
+            expect(saveState(loaded.processor) == blob, "junk was loaded");
+        }
+
+        beginTest("XML saved before the binary format");
+        {
+            juce::MemoryBlock xmlState;
+
+            if (auto xml = saved.processor.treeState.copyState().createXml())
+                juce::AudioProcessor::copyXmlToBinary(*xml, xmlState);
+
+            expect(! StateFormat::isBinaryState(xmlState.getData(), (int)xmlState.getSize()));
+
+            // the parameters come from the XML, the lanes, seed and groove it never had go back to their defaults
+            ProcessorHarness loaded;
+            loadState(loaded.processor, blob);
+            loadState(loaded.processor, xmlState);
+
+            expectParametersMatch(loaded, saved);
+            expectEquals((int)loaded.processor.getRandomSeed(), 0);
+            expectEquals(loaded.processor.getStepVelocity(2, 5), (int)StepLanes::defaultVelocity);
+            expectEquals(loaded.processor.getStepProbability(3, 31), (int)StepLanes::alwaysPlays);
+            expectEquals(loaded.processor.getStepRatchet(1, 7), 1);
+            expectEquals(loaded.processor.getGrooveTemplate().length, 0);
+        }
+    }
+
+private:
+    // every field the current version saves moved off its default
+    static void changeEverything(ProcessorHarness& harness)
+    {
+        harness.setParameter("Speed", 1.0f);
+        harness.setParameter("Sync", 1.0f);
+        harness.setParameter("Dot", 0.0f);
+        harness.setParameter("Trip", 1.0f);
+        harness.setParameter("Quantize", 1.0f);
+        harness.setParameter("MidiThru", 0.0f);
+        harness.setParameter("FollowInput", 1.0f);
+        harness.setParameter("Retrigger", 1.0f);
+        harness.setParameter("Swing", 62.5f);
+        harness.setParameter("Lookahead", 25.0f);
+
+        for (int i = 0; i < numOrbits; i++)
+        {
+            auto id = juce::String(i + 1);
+            harness.setOrbit(i, i % 2 == 0, 9 + i, 2 + i, 3);
+            harness.setParameter("Reversed" + id, 1.0f);
+            harness.setParameter("OutputNote" + id, (float)(i + 2));
+            harness.setParameter("iOctave" + id, -1.0f);
+            harness.setParameter("Rotation" + id, (float)(i + 1));
+            harness.setParameter("Channel" + id, (float)(16 - i));
+            harness.setParameter("GateMode" + id, 1.0f);
+            harness.setParameter("GateLength" + id, 40.0f);
+            harness.setParameter("GateTime" + id, 600.0f);
+        }
+
+        auto& processor = harness.processor;
+        processor.setStepVelocity(2, 5, 17);
+        processor.setStepProbability(3, 31, 40);
+        processor.setStepRatchet(1, 7, 6);
+        processor.setRandomSeed(0x5eed);
+
+        Groove::Template groove;
+        groove.length = 3;
+        groove.offsets[0] = 0.25f;
+        groove.offsets[1] = -0.125f;
+        processor.setGrooveTemplate(groove);
+    }
+
+    void expectParametersMatch(ProcessorHarness& loaded, ProcessorHarness& saved)
+    {
+        auto& a = loaded.processor.getParameters();
+        auto& b = saved.processor.getParameters();
+        expectEquals(a.size(), b.size());
+
+        for (int i = 0; i < juce::jmin(a.size(), b.size()); i++)
+            if (a[i]->getValue() != b[i]->getValue())
+            {
+                expect(false, "parameter " + juce::String(i) + " is " + juce::String(a[i]->getValue())
+                                  + ", saved as " + juce::String(b[i]->getValue()));
+                break;
+            }
+    }
+};
+
+static StateTests stateTests;
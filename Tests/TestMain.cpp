@@ -0,0 +1,26 @@
+/*
+  ==============================================================================
+
+    Runs every juce::UnitTest in the "Euclid" category, failing when any of
+    them does.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runTestsInCategory("Euclid");
+
+    auto failures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); i++)
+        failures += runner.getResult(i)->failures;
+
+    return failures > 0 ? 1 : 0;
+}